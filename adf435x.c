@@ -21,22 +21,90 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <float.h>
-#include <math.h>
+#include <stdarg.h>
+#include <string.h>
 #include "adf435x.h"
 
+// The AVX batch kernel is built on x86 with GCC or Clang whatever the -m
+// flags, and only used if the CPU reports AVX at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ADF435X_BATCH_AVX
+#endif
+
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
-static float ADF435x_fGCD(float a, float b);
-static bool ADF435x_bCheckUint(char *acName, uint32_t u32Val, uint32_t u32Max);
-static bool ADF435x_bCheckLookupVal(char *acName, float fVal, float *pfArray, int iArrayLen);
-static int ADF435x_iLookupVal(float fVal, float *pfArray, int iArrayLen);
-static ADF435X_teVerbosity ADF435x_eVerbosity;
+static const float ADF435x_afChargePumpCurrent[] = {0.31, 0.63, 0.94, 1.25, 1.56, 1.88, 2.19, 2.50, 2.81, 3.13, 3.44, 3.75, 4.06, 4.38, 4.49, 5.00};
+static const float ADF435x_afABP[] = {10, 6};
+
+static uint64_t ADF435x_u64GCD(uint64_t a, uint64_t b);
+static int ADF435x_iCountTrailingZeros(uint64_t u64Val);
+static void ADF435x_vBestFraction(uint64_t u64Num, uint64_t u64Den, uint64_t u64MaxDen, uint64_t *pu64Num, uint64_t *pu64Den);
+static void ADF435x_vBatchScalar(ADF435x_tsContext *psContext, const uint64_t *pu64Frequency, size_t uStart, size_t uEnd, ADF435X_tsSettingsBatch *psBatch);
+#if defined(ADF435X_BATCH_AVX)
+__attribute__((target("avx"))) static size_t ADF435x_uBatchAVX(ADF435x_tsContext *psContext, const uint64_t *pu64Frequency, size_t uCount, ADF435X_tsSettingsBatch *psBatch);
+#endif
+static bool ADF435x_bCheckUint(ADF435x_tsContext *psContext, char *acName, uint32_t u32Val, uint32_t u32Max);
+static bool ADF435x_bCheckLookupVal(ADF435x_tsContext *psContext, char *acName, float fVal, const float *pfArray, int iArrayLen);
+static int ADF435x_iLookupVal(ADF435x_tsContext *psContext, float fVal, const float *pfArray, int iArrayLen);
+static bool ADF435x_bCompileOptions(ADF435x_tsContext *psContext);
+
+// Sets up a context for one synthesizer. Everything the calculation needs is
+// held in the context, so separate contexts may be used from separate
+// threads at the same time. Returns false if the options are not valid.
+bool ADF435x_bInitContext(ADF435x_tsContext *psContext, ADF435x_tsOptions *psOptions, ADF435X_teVerbosity eVerbosity)
+{
+    memset(psContext, 0, sizeof(ADF435x_tsContext));
+    psContext->eVerbosity = eVerbosity;
+    return ADF435x_bSetOptions(psContext, psOptions);
+}
+
+// Copies in new options and recalculates the values derived from them,
+// including the register bits that do not depend on frequency. Returns false
+// if the options are not valid.
+bool ADF435x_bSetOptions(ADF435x_tsContext *psContext, ADF435x_tsOptions *psOptions)
+{
+    psContext->sOptions = *psOptions;
+
+    // The PFD frequency is Fref * (1 + D) / (R * (1 + T)), kept as an exact
+    // fraction for N and truncated to whole Hz for the limit checks
+    psContext->u64PFDNumerator = psOptions->u64ReferenceFrequencyHz * (psOptions->bRefDoubler ? 2 : 1);
+    psContext->u64PFDDenominator = (uint64_t)(psOptions->bRefDiv2 ? 2 : 1) * psOptions->u32RCounter;
+    psContext->u64PFDFreqHz = psContext->u64PFDDenominator ? psContext->u64PFDNumerator / psContext->u64PFDDenominator : 0;
+    psContext->u64ChannelMod = psOptions->u64ChannelSpacingHz ? psOptions->u64ReferenceFrequencyHz / psOptions->u64ChannelSpacingHz : 0;
+
+    // A fixed MOD replaces the channel spacing and is never reduced, so that
+    // R1 stays the same from one frequency to the next
+    psContext->bReduceFracMod = psOptions->bEnableGCD;
+    if(psOptions->u32FixedMod != 0)
+    {
+        psContext->u64ChannelMod = psOptions->u32FixedMod;
+        psContext->bReduceFracMod = false;
+    }
+
+    psContext->u64BandSelectClockDivider = 0;
+    if(psOptions->eBandSelectClockMode == E_ADF435X_BAND_SELECT_CLOCK_MODE_LOW)
+    {
+        psContext->u64BandSelectClockDivider = MIN((8 * psContext->u64PFDFreqHz) / 1000000, 255);
+    }
+
+    return ADF435x_bCompileOptions(psContext);
+}
+
+void ADF435x_vSetError(ADF435x_tsContext *psContext, const char *pcFormat, ...)
+{
+    va_list ap;
+
+    va_start(ap, pcFormat);
+    vsnprintf(psContext->acError, sizeof(psContext->acError), pcFormat, ap);
+    va_end(ap);
+}
 
-void ADF435x_vInit(ADF435X_teVerbosity eVerbosity)
+// Description of the last error, empty if there has not been one
+const char *ADF435x_pcGetError(ADF435x_tsContext *psContext)
 {
-    ADF435x_eVerbosity = eVerbosity;
+    return psContext->acError;
 }
 
 // Fills on an options struct with the defaults
@@ -70,6 +138,8 @@ void ADF435x_vGetOptions(ADF435x_tsOptions *psOptions)
     psOptions->bRefDoubler = false;
     psOptions->bRefDiv2 = false;
     psOptions->bEnableGCD = true;
+    psOptions->bBestFracMod = false;
+    psOptions->u32FixedMod = 0;
 
     psOptions->bDoubleBufR4 = false;
     psOptions->bPowerDown = false;
@@ -83,20 +153,25 @@ void ADF435x_vGetOptions(ADF435x_tsOptions *psOptions)
     psOptions->bOutputEnable = true;
 }
 
-bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOptions, ADF435X_tsSettings *psSettings)
+bool ADF435x_bCalculateSettings(ADF435x_tsContext *psContext, uint64_t u64Frequency, ADF435X_tsSettings *psSettings)
 {
+    ADF435x_tsOptions *psOptions = &psContext->sOptions;
 
     psSettings->u64BandSelectClockDivider = 0;
     psSettings->u64OutputDivider = 0;
 
     uint64_t u64N;
-    uint64_t u64Div;
+    uint64_t u64Div = 1;
     uint64_t u64PFDScale;
     uint64_t u64BandSelectClockFrequency;
+    uint64_t u64NNumerator;
+    uint64_t u64NDenominator;
 
-    uint64_t u64PFDFreqHz = ((psOptions->u64ReferenceFrequencyHz * (psOptions->bRefDoubler ? 2.0 : 1.0)) / ((psOptions->bRefDiv2 ? 2.0 : 1.0) * psOptions->u32RCounter));
+    uint64_t u64PFDNumerator = psContext->u64PFDNumerator;
+    uint64_t u64PFDDenominator = psContext->u64PFDDenominator;
+    uint64_t u64PFDFreqHz = psContext->u64PFDFreqHz;
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Frequency = %d.%dMHz   PFD Frequency=%d.%dMHz\n", u64Frequency / 1000000, u64Frequency % 1000000, u64PFDFreqHz / 1000000, u64PFDFreqHz % 1000000);
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Frequency = %d.%dMHz   PFD Frequency=%d.%dMHz\n", u64Frequency / 1000000, u64Frequency % 1000000, u64PFDFreqHz / 1000000, u64PFDFreqHz % 1000000);
 
     // Calculate the output divider
     for(int n = 0; n < 7; n++)
@@ -108,42 +183,71 @@ bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOpti
         }
     }
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Output Divider = %d\n", psSettings->u64OutputDivider);
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Output Divider = %d\n", psSettings->u64OutputDivider);
 
+    // N = Fvco / Fpfd as an exact fraction
     if(psOptions->eFeedbackSelect == E_ADF435X_FEEDBACK_SELECT_FUNDAMENTAL)
     {
-        u64N = u64Frequency * psSettings->u64OutputDivider * 1000 / u64PFDFreqHz;
+        u64NNumerator = u64Frequency * psSettings->u64OutputDivider * u64PFDDenominator;
     }
     else
     {
-        u64N = u64Frequency * 1000 / u64PFDFreqHz;
+        u64NNumerator = u64Frequency * u64PFDDenominator;
+    }
+    u64NDenominator = u64PFDNumerator;
+
+    psSettings->u64Int = u64NNumerator / u64NDenominator;
+
+    if(psOptions->bBestFracMod)
+    {
+        // Closest FRAC/MOD to the fractional part of N with MOD <= 4095
+        ADF435x_vBestFraction(u64NNumerator % u64NDenominator, u64NDenominator, 4095, &psSettings->u64Frac, &psSettings->u64Mod);
+    }
+    else
+    {
+        // FRAC is the remainder scaled to MOD, rounded to the nearest step
+        psSettings->u64Mod = psContext->u64ChannelMod;
+        psSettings->u64Frac = ((u64NNumerator % u64NDenominator) * psSettings->u64Mod * 2 + u64NDenominator) / (2 * u64NDenominator);
+    }
+
+    if(psSettings->u64Frac == psSettings->u64Mod)
+    {
+        psSettings->u64Int++;
+        psSettings->u64Frac = 0;
     }
 
-    psSettings->u64Int = u64N / 1000;
-    psSettings->u64Mod = psOptions->u64ReferenceFrequencyHz / psOptions->u64ChannelSpacingHz;
-    psSettings->u64Frac = ((u64N % 1000) * psSettings->u64Mod) / 1000;
+    // N in thousandths, for display only
+    u64N = psSettings->u64Int * 1000 + (psSettings->u64Mod ? (psSettings->u64Frac * 1000) / psSettings->u64Mod : 0);
 
-    if(psOptions->bEnableGCD)
+    if(psContext->bReduceFracMod)
     {
-        u64Div = ADF435x_fGCD(psSettings->u64Mod, psSettings->u64Frac);
+        u64Div = ADF435x_u64GCD(psSettings->u64Mod, psSettings->u64Frac);
         psSettings->u64Mod = psSettings->u64Mod / u64Div;
         psSettings->u64Frac = psSettings->u64Frac / u64Div;
     }
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("DIV=%d\n", u64Div);
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("DIV=%d\n", u64Div);
 
     if(psSettings->u64Mod == 1)
     {
         psSettings->u64Mod = 2;
     }
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("N=%d.%03d INT=%d MOD=%d FRAC=%d\n", u64N / 1000, u64N % 1000, psSettings->u64Int, psSettings->u64Mod, psSettings->u64Frac);
+    // Residual error of the output frequency, (INT + FRAC / MOD) - N scaled to Hz
+    psSettings->dFrequencyErrorHz = (double)((int64_t)((psSettings->u64Int * psSettings->u64Mod + psSettings->u64Frac) * u64NDenominator) -
+                                             (int64_t)(u64NNumerator * psSettings->u64Mod)) /
+                                    (double)(psSettings->u64Mod * u64PFDDenominator *
+                                             (psOptions->eFeedbackSelect == E_ADF435X_FEEDBACK_SELECT_FUNDAMENTAL ? psSettings->u64OutputDivider : 1));
+
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Frequency error=%.3fHz\n", psSettings->dFrequencyErrorHz);
+
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("N=%d.%03d INT=%d MOD=%d FRAC=%d\n", u64N / 1000, u64N % 1000, psSettings->u64Int, psSettings->u64Mod, psSettings->u64Frac);
 
     if(u64PFDFreqHz > 32000000)
     {
         if(psSettings->u64Frac != 0)
         {
-            printf("Maximum PFD frequency in Frac-N mode (FRAC != 0) is 32MHz.\n");
+            ADF435x_vSetError(psContext, "Maximum PFD frequency in Frac-N mode (FRAC != 0) is 32MHz.");
             return false;
         }
 
@@ -151,12 +255,12 @@ bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOpti
         {
             if(u64PFDFreqHz > 90000000)
             {
-                printf("Maximum PFD frequency in Int-N mode (FRAC = 0) is 90MHz.\n");
+                ADF435x_vSetError(psContext, "Maximum PFD frequency in Int-N mode (FRAC = 0) is 90MHz.");
                 return false;
             }
             if(psOptions->eBandSelectClockMode == E_ADF435X_BAND_SELECT_CLOCK_MODE_LOW)
             {
-                printf("Band Select Clock Mode must be set to High when PFD is >32MHz in Int-N mode (FRAC = 0).\n");
+                ADF435x_vSetError(psContext, "Band Select Clock Mode must be set to High when PFD is >32MHz in Int-N mode (FRAC = 0).");
                 return false;
             }
         }
@@ -167,7 +271,7 @@ bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOpti
         if(psOptions->eBandSelectClockMode == E_ADF435X_BAND_SELECT_CLOCK_MODE_LOW)
         {
             u64PFDScale = 8;
-            psSettings->u64BandSelectClockDivider = MIN((8 * u64PFDFreqHz) / 1000000, 255);
+            psSettings->u64BandSelectClockDivider = psContext->u64BandSelectClockDivider;
         }
         else
         {
@@ -177,11 +281,11 @@ bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOpti
 
     u64BandSelectClockFrequency = u64PFDFreqHz / psSettings->u64BandSelectClockDivider;
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("BandSelectClockDivider=%d BandSelectClockFrequency=%d\n", psSettings->u64BandSelectClockDivider, u64BandSelectClockFrequency);
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("BandSelectClockDivider=%d BandSelectClockFrequency=%d\n", psSettings->u64BandSelectClockDivider, u64BandSelectClockFrequency);
 
     if(u64BandSelectClockFrequency > 500000)
     {
-        printf("Band Select Clock Frequency is too High. It must be 500kHz or less. Currently=%d\n", u64BandSelectClockFrequency);
+        ADF435x_vSetError(psContext, "Band Select Clock Frequency is too High. It must be 500kHz or less. Currently=%d", u64BandSelectClockFrequency);
         return false;
     }
     else if(u64BandSelectClockFrequency > 125000000)
@@ -190,155 +294,558 @@ bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOpti
         {
             if(psOptions->eBandSelectClockMode == E_ADF435X_BAND_SELECT_CLOCK_MODE_LOW)
             {
-                printf("Band Select Clock Frequency is too high. Reduce to 125kHz or less, or set Band Select Clock Mode to High.\n");
+                ADF435x_vSetError(psContext, "Band Select Clock Frequency is too high. Reduce to 125kHz or less, or set Band Select Clock Mode to High.");
                 return false;
             }
         }
         else
         {
-            printf("Band Select Clock Frequency is too high. Reduce to 125kHz or less.\n");
+            ADF435x_vSetError(psContext, "Band Select Clock Frequency is too high. Reduce to 125kHz or less.");
             return false;
         }
 
     }
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Settings: INT=%d FRAC=%d MOD=%d ClkDiv=%d OutputDiv=%d\n", psSettings->u64Int, psSettings->u64Frac, psSettings->u64Mod, psSettings->u64BandSelectClockDivider, psSettings->u64OutputDivider);
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("Settings: INT=%d FRAC=%d MOD=%d ClkDiv=%d OutputDiv=%d\n", psSettings->u64Int, psSettings->u64Frac, psSettings->u64Mod, psSettings->u64BandSelectClockDivider, psSettings->u64OutputDivider);
 
     return true;
 }
 
-bool ADF435x_bGenerateRegisters(ADF435x_tsOptions *psOptions, ADF435X_tsSettings *psSettings, ADF435X_tuRegisters *puRegisters)
+bool ADF435x_bGenerateRegisters(ADF435x_tsContext *psContext, ADF435X_tsSettings *psSettings, ADF435X_tuRegisters *puRegisters)
 {
-
-    float afChargePumpCurrent[] = {0.31, 0.63, 0.94, 1.25, 1.56, 1.88, 2.19, 2.50, 2.81, 3.13, 3.44, 3.75, 4.06, 4.38, 4.49, 5.00};
-    float afABP[] = {10, 6};
-    float afOutputPower[] = {-4, -1, 2, 5};
-
-    // uint32_t u32BandSelectClockDivider = 200;
-
     uint32_t u32OutputDividerSelect;
 
     bool bOk = true;
 
-    bOk &= ADF435x_bCheckUint("INT", psSettings->u64Int, 65535);
-    bOk &= ADF435x_bCheckUint("FRAC", psSettings->u64Frac, 4095);
-    bOk &= ADF435x_bCheckUint("MOD", psSettings->u64Mod, 4095);
+    // Options that failed to compile are checked again, to report why
+    if(!psContext->bCompiled && !ADF435x_bCompileOptions(psContext))
+    {
+        return false;
+    }
 
-    bOk &= ADF435x_bCheckLookupVal("ChargePumpCurrent", psOptions->fChargePumpCurrent, afChargePumpCurrent, sizeof(afChargePumpCurrent) / sizeof(float));
-    bOk &= ADF435x_bCheckLookupVal("ABP", psOptions->fABP, afABP, sizeof(afABP) / sizeof(float));
+    bOk &= ADF435x_bCheckUint(psContext, "INT", psSettings->u64Int, 65535);
+    bOk &= ADF435x_bCheckUint(psContext, "FRAC", psSettings->u64Frac, 4095);
+    bOk &= ADF435x_bCheckUint(psContext, "MOD", psSettings->u64Mod, 4095);
 
     if(!bOk) return false;
 
 
-    u32OutputDividerSelect = log2(psSettings->u64OutputDivider);
-    if(u32OutputDividerSelect < 0 || u32OutputDividerSelect > 64 || floor(u32OutputDividerSelect) != u32OutputDividerSelect)
+    if(psSettings->u64OutputDivider == 0 || psSettings->u64OutputDivider > 64 || (psSettings->u64OutputDivider & (psSettings->u64OutputDivider - 1)) != 0)
     {
-        printf("Output Divider must be a positive integer power of 2, not greater than 64.\n");
+        ADF435x_vSetError(psContext, "Output Divider must be a positive integer power of 2, not greater than 64.");
         return false;
     }
+    u32OutputDividerSelect = ADF435x_iCountTrailingZeros(psSettings->u64OutputDivider);
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("OutputDivider=%d OutputDividerSelect=%x\n", psSettings->u64OutputDivider, u32OutputDividerSelect);
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("OutputDivider=%d OutputDividerSelect=%x\n", psSettings->u64OutputDivider, u32OutputDividerSelect);
 
-    // R0
-    puRegisters->u32Register0 = ((uint32_t)psSettings->u64Int) << 15 |
-                                ((uint32_t)psSettings->u64Frac) << 3 |
-                                0x0;
+    // Only these fields depend on frequency, the rest was packed when the
+    // options were compiled
+    *puRegisters = psContext->uBase;
+    puRegisters->u32Register0 |= ((uint32_t)psSettings->u64Int) << 15 |
+                                 ((uint32_t)psSettings->u64Frac) << 3;
+    puRegisters->u32Register1 |= (uint32_t)psSettings->u64Mod << 3;
+    puRegisters->u32Register2 |= (psSettings->u64Frac == 0 ? 0 : 1) << 8;
+    puRegisters->u32Register4 |= u32OutputDividerSelect << 20 |
+                                 psSettings->u64BandSelectClockDivider << 12;
 
-    // R1
-    puRegisters->u32Register1 = (psOptions->u32PhaseValue != 0 ? 1 : 0) << 28 |
-                                (psOptions->ePrescaler == E_ADF435X_PRESCALER_8_OVER_9 ? 1 : 0) << 27 |
-                                (psOptions->u32PhaseValue == 0 ? 1 : 0) << 15 |
-                                (uint32_t)psSettings->u64Mod << 3 |
-                                0x1;
+    if(psContext->eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("R0=%8x R1=%8x R2=%8x R3=%8x R4=%8x R5=%8x\n", puRegisters->u32Register0, puRegisters->u32Register1, puRegisters->u32Register2, puRegisters->u32Register3, puRegisters->u32Register4, puRegisters->u32Register5);
+    // printf("R0=%8x R1=%8x R2=%8x R3=%8x R4=%8x R5=%8x\n", puRegisters->u32Register0, puRegisters->u32Register1, puRegisters->u32Register2, puRegisters->u32Register3, puRegisters->u32Register4, puRegisters->u32Register5);
 
-    // R2
-    puRegisters->u32Register2 = (uint32_t)psOptions->eLowNoiseOrLowSpurMode << 29 |
-                                (uint32_t)psOptions->eMuxOut << 26 |
-                                (psOptions->bRefDoubler ? 1 : 0) << 25 |
-                                (psOptions->bRefDiv2 ? 1 : 0) << 24 |
-                                psOptions->u32RCounter << 14 |
-                                (psOptions->bDoubleBufR4 ? 1 : 0) << 13 |
-                                ADF435x_iLookupVal(psOptions->fChargePumpCurrent, afChargePumpCurrent, sizeof(afChargePumpCurrent) / sizeof(float)) << 9 |
-                                (psSettings->u64Frac == 0 ? 0 : 1) << 8 |
-                                (psOptions->fLDP == 10.0 ? 0 : 1) << 7 |
-                                (uint32_t)psOptions->ePDPolarity << 6 |
-                                (psOptions->bPowerDown ? 1 : 0) << 5 |
-                                (psOptions->bCPTristate ? 1 : 0) << 4 |
-                                (psOptions->bCounterReset ? 1 : 0) << 3 |
-                                0x2;
+    return true;
+}
 
-    // R3
-    puRegisters->u32Register3 = (psOptions->bCSR ? 1 : 0) << 18 |
-                                (uint32_t)psOptions->eClockDivMode << 15 |
-                                psOptions->u32ClockDividerValue << 3 |
-                                0x3;
-    
-    if(psOptions->eDeviceType == E_ADF435X_DEVICE_TYPE_ADF4351)
+bool ADF435x_bAllocBatch(ADF435X_tsSettingsBatch *psBatch, size_t uCount)
+{
+    uint32_t *pu32Block;
+
+    memset(psBatch, 0, sizeof(ADF435X_tsSettingsBatch));
+
+    // One block for all ten arrays, freed through pu32Int
+    pu32Block = malloc((uCount ? uCount : 1) * 10 * sizeof(uint32_t));
+    if(pu32Block == NULL)
     {
-        puRegisters->u32Register3 |= (uint32_t)psOptions->eBandSelectClockMode << 23 |
-                                        ADF435x_iLookupVal(psOptions->fABP, afABP, sizeof(afABP) / sizeof(float)) << 22 |
-                                        (psOptions->bChargeCancel ? 1 : 0) << 21;
+        return false;
     }
 
-    // R4
-    puRegisters->u32Register4 = (uint32_t)psOptions->eFeedbackSelect << 23 |
-                                u32OutputDividerSelect << 20 |
-                                psSettings->u64BandSelectClockDivider << 12 |
-                                (psOptions->bVCOPowerDown ? 1 : 0) << 11 |
-                                (psOptions->bMuteTillLockDetect ? 1 : 0) << 10 |
-                                (uint32_t)psOptions->eAuxOutputSelect << 9 |
-                                (psOptions->bAuxOutputEnable ? 1 : 0) << 8 |
-                                (uint32_t)psOptions->eAuxOutputPower << 6 |
-                                (psOptions->bOutputEnable ? 1 : 0) << 5 |
-                                (uint32_t)psOptions->eOutputPower << 3 |
-                                0x4;
+    psBatch->uCount = uCount;
+    psBatch->uFirstInvalid = uCount;
+    psBatch->pu32Int = pu32Block;
+    psBatch->pu32Frac = pu32Block + uCount;
+    psBatch->pu32Mod = pu32Block + 2 * uCount;
+    psBatch->pu32OutputDividerSelect = pu32Block + 3 * uCount;
+    for(int n = 0; n < 6; n++)
+    {
+        psBatch->apu32Registers[n] = pu32Block + (4 + n) * uCount;
+    }
 
-    // R5
-    puRegisters->u32Register5 = (uint32_t)psOptions->eLDPinMode << 22 |
-                                3 << 19 |
-                                0x5;
+    return true;
+}
 
+void ADF435x_vFreeBatch(ADF435X_tsSettingsBatch *psBatch)
+{
+    free(psBatch->pu32Int);
+    memset(psBatch, 0, sizeof(ADF435X_tsSettingsBatch));
+}
 
-    if(ADF435x_eVerbosity >= E_ADF435X_VERBOSITY_HIGH) printf("R0=%8x R1=%8x R2=%8x R3=%8x R4=%8x R5=%8x\n", puRegisters->u32Register0, puRegisters->u32Register1, puRegisters->u32Register2, puRegisters->u32Register3, puRegisters->u32Register4, puRegisters->u32Register5);
-    // printf("R0=%8x R1=%8x R2=%8x R3=%8x R4=%8x R5=%8x\n", puRegisters->u32Register0, puRegisters->u32Register1, puRegisters->u32Register2, puRegisters->u32Register3, puRegisters->u32Register4, puRegisters->u32Register5);
+// Calculates INT/FRAC/MOD and the output divider for psBatch->uCount
+// frequencies. Gives the same results as ADF435x_bCalculateSettings() but
+// the checks that do not depend on frequency are made once, using the first
+// point, and nothing is printed per point. Returns false if any point is
+// invalid, psBatch->uFirstInvalid is the first one.
+bool ADF435x_bCalculateSettingsBatch(ADF435x_tsContext *psContext, const uint64_t *pu64Frequency, ADF435X_tsSettingsBatch *psBatch)
+{
+    ADF435x_tsOptions *psOptions = &psContext->sOptions;
+    ADF435X_tsSettings sSettings;
+    uint64_t u64PFDFreqHz = psContext->u64PFDFreqHz;
+    uint64_t u64Mod = psContext->u64ChannelMod;
+    uint16_t *pu16GCD = NULL;
+    size_t uDone = 0;
+    bool bOk;
+
+    psBatch->uFirstInvalid = psBatch->uCount;
+
+    if(psBatch->uCount == 0)
+    {
+        return true;
+    }
+
+    // Frequency independent checks
+    bOk = ADF435x_bCalculateSettings(psContext, pu64Frequency[0], &sSettings);
+    if(!bOk)
+    {
+        psBatch->uFirstInvalid = 0;
+        return false;
+    }
+
+#if defined(ADF435X_BATCH_AVX)
+    if(!psOptions->bBestFracMod && __builtin_cpu_supports("avx"))
+    {
+        uDone = ADF435x_uBatchAVX(psContext, pu64Frequency, psBatch->uCount, psBatch);
+    }
+#endif
+
+    ADF435x_vBatchScalar(psContext, pu64Frequency, uDone, psBatch->uCount, psBatch);
+
+    // Reduce, then check each point as ADF435x_bCalculateSettings() and
+    // ADF435x_bGenerateRegisters() would
+
+    // With a fixed MOD every GCD is one of at most MOD values, so tabulate them
+    if(psContext->bReduceFracMod && !psOptions->bBestFracMod && u64Mod <= 4095 && psBatch->uCount > u64Mod)
+    {
+        pu16GCD = malloc((size_t)u64Mod * sizeof(uint16_t));
+        for(uint64_t n = 0; pu16GCD != NULL && n < u64Mod; n++)
+        {
+            pu16GCD[n] = (uint16_t)ADF435x_u64GCD(u64Mod, n);
+        }
+    }
+
+    for(size_t n = 0; n < psBatch->uCount; n++)
+    {
+        uint32_t u32Frac = psBatch->pu32Frac[n];
+        uint32_t u32Mod = psBatch->pu32Mod[n];
+
+        if(psContext->bReduceFracMod)
+        {
+            uint32_t u32Div = pu16GCD != NULL ? pu16GCD[u32Frac] : (uint32_t)ADF435x_u64GCD(u32Mod, u32Frac);
+            u32Mod /= u32Div;
+            u32Frac /= u32Div;
+        }
+        if(u32Mod == 1)
+        {
+            u32Mod = 2;
+        }
+        psBatch->pu32Frac[n] = u32Frac;
+        psBatch->pu32Mod[n] = u32Mod;
+
+        if(psBatch->pu32Int[n] > 65535 || u32Frac > 4095 || u32Mod > 4095 || (u32Frac != 0 && u64PFDFreqHz > 32000000))
+        {
+            if(psBatch->uFirstInvalid == psBatch->uCount)
+            {
+                psBatch->uFirstInvalid = n;
+                ADF435x_vSetError(psContext, "INT=%u FRAC=%u MOD=%u is out of range.", psBatch->pu32Int[n], u32Frac, u32Mod);
+            }
+        }
+    }
+
+    free(pu16GCD);
+
+    return psBatch->uFirstInvalid == psBatch->uCount;
+}
+
+// Packs the register words for a calculated batch. The frequency independent
+// bits come from the compiled options, only the INT, FRAC, MOD, LDF and
+// divider select fields are filled in per point.
+bool ADF435x_bGenerateRegistersBatch(ADF435x_tsContext *psContext, ADF435X_tsSettingsBatch *psBatch)
+{
+    ADF435X_tuRegisters uBase;
+
+    if(psBatch->uCount == 0)
+    {
+        return true;
+    }
+
+    if(!psContext->bCompiled && !ADF435x_bCompileOptions(psContext))
+    {
+        return false;
+    }
+
+    uBase = psContext->uBase;
+    uBase.u32Register4 |= psContext->u64BandSelectClockDivider << 12;
+
+    for(size_t n = 0; n < psBatch->uCount; n++)
+    {
+        psBatch->apu32Registers[0][n] = psBatch->pu32Int[n] << 15 | psBatch->pu32Frac[n] << 3;
+        psBatch->apu32Registers[1][n] = uBase.u32Register1 | psBatch->pu32Mod[n] << 3;
+        psBatch->apu32Registers[2][n] = uBase.u32Register2 | (psBatch->pu32Frac[n] != 0) << 8;
+        psBatch->apu32Registers[3][n] = uBase.u32Register3;
+        psBatch->apu32Registers[4][n] = uBase.u32Register4 | psBatch->pu32OutputDividerSelect[n] << 20;
+        psBatch->apu32Registers[5][n] = uBase.u32Register5;
+    }
 
     return true;
 }
 
-static float ADF435x_fGCD(float a, float b)
+// INT/FRAC/MOD and divider select for points uStart to uEnd, before GCD
+// reduction, exactly as ADF435x_bCalculateSettings() computes them
+static void ADF435x_vBatchScalar(ADF435x_tsContext *psContext, const uint64_t *pu64Frequency, size_t uStart, size_t uEnd, ADF435X_tsSettingsBatch *psBatch)
 {
-    while(1)
+    ADF435x_tsOptions *psOptions = &psContext->sOptions;
+    uint64_t u64PFDNumerator = psContext->u64PFDNumerator;
+    uint64_t u64PFDDenominator = psContext->u64PFDDenominator;
+    uint64_t u64ModSpacing = psContext->u64ChannelMod;
+    bool bFundamental = psOptions->eFeedbackSelect == E_ADF435X_FEEDBACK_SELECT_FUNDAMENTAL;
+
+    for(size_t n = uStart; n < uEnd; n++)
     {
-        if(a == 0.0)
+        uint64_t u64Frequency = pu64Frequency[n];
+        uint64_t u64Int, u64Frac, u64Mod, u64Rem, u64Num;
+        uint32_t u32Select = 0;
+
+        while(u32Select < 6 && (2200000000ULL >> u32Select) > u64Frequency)
         {
-            return b;
+            u32Select++;
         }
-        else if(b == 0.0)
+
+        u64Num = u64Frequency * (bFundamental ? (1ULL << u32Select) : 1) * u64PFDDenominator;
+        u64Int = u64Num / u64PFDNumerator;
+        u64Rem = u64Num % u64PFDNumerator;
+
+        if(psOptions->bBestFracMod)
         {
-            return a;
+            ADF435x_vBestFraction(u64Rem, u64PFDNumerator, 4095, &u64Frac, &u64Mod);
         }
-        else if(a > b)
+        else
         {
-            a = fmod(a, b);
+            u64Mod = u64ModSpacing;
+            u64Frac = (u64Rem * u64Mod * 2 + u64PFDNumerator) / (2 * u64PFDNumerator);
         }
-        else
+
+        if(u64Frac == u64Mod)
+        {
+            u64Int++;
+            u64Frac = 0;
+        }
+
+        psBatch->pu32Int[n] = u64Int > UINT32_MAX ? UINT32_MAX : (uint32_t)u64Int;
+        psBatch->pu32Frac[n] = (uint32_t)u64Frac;
+        psBatch->pu32Mod[n] = (uint32_t)u64Mod;
+        psBatch->pu32OutputDividerSelect[n] = u32Select;
+    }
+}
+
+#if defined(ADF435X_BATCH_AVX)
+// Four points per iteration in double precision lanes. Every intermediate is
+// an integer below 2^53 so it is exact, and each floor division is corrected
+// by one step of integer remainder arithmetic, which makes the results
+// identical to ADF435x_vBatchScalar(). Returns the number of points done.
+__attribute__((target("avx"))) static size_t ADF435x_uBatchAVX(ADF435x_tsContext *psContext, const uint64_t *pu64Frequency, size_t uCount, ADF435X_tsSettingsBatch *psBatch)
+{
+    ADF435x_tsOptions *psOptions = &psContext->sOptions;
+    uint64_t u64PFDNumerator = psContext->u64PFDNumerator;
+    uint64_t u64PFDDenominator = psContext->u64PFDDenominator;
+    uint64_t u64Mod = psContext->u64ChannelMod;
+    bool bFundamental = psOptions->eFeedbackSelect == E_ADF435X_FEEDBACK_SELECT_FUNDAMENTAL;
+    size_t n;
+
+    // Limits for exactness: frequency and PFD numerator below 2^40 and 2^39, so
+    // VCO * R * (1 + T) and remainder * 2 * MOD + den stay below 2^53
+    if(u64PFDNumerator >= (1ULL << 39) || u64PFDDenominator * 64 >= (1ULL << 12) || u64Mod >= (1ULL << 12))
+    {
+        return 0;
+    }
+
+    const __m256d vDen = _mm256_set1_pd((double)u64PFDNumerator);
+    const __m256d vDen2 = _mm256_set1_pd(2.0 * u64PFDNumerator);
+    const __m256d vPFDDen = _mm256_set1_pd((double)u64PFDDenominator);
+    const __m256d vMod = _mm256_set1_pd((double)u64Mod);
+    const __m256d vTwoMod = _mm256_set1_pd(2.0 * u64Mod);
+    const __m256d vZero = _mm256_setzero_pd();
+    const __m256d vOne = _mm256_set1_pd(1.0);
+
+    for(n = 0; n + 4 <= uCount; n += 4)
+    {
+        if(pu64Frequency[n] >= (1ULL << 40) || pu64Frequency[n + 1] >= (1ULL << 40) ||
+           pu64Frequency[n + 2] >= (1ULL << 40) || pu64Frequency[n + 3] >= (1ULL << 40))
+        {
+            break;
+        }
+
+        __m256d vFreq = _mm256_set_pd((double)pu64Frequency[n + 3], (double)pu64Frequency[n + 2], (double)pu64Frequency[n + 1], (double)pu64Frequency[n]);
+        __m256d vSelect = vZero;
+        __m256d vMult = vOne;
+
+        // Output divider, doubled while 2.2GHz / divider is above the frequency
+        for(int i = 0; i < 6; i++)
+        {
+            __m256d vMask = _mm256_cmp_pd(_mm256_set1_pd((double)(2200000000ULL >> i)), vFreq, _CMP_GT_OQ);
+            vSelect = _mm256_add_pd(vSelect, _mm256_and_pd(vMask, vOne));
+            vMult = _mm256_blendv_pd(vMult, _mm256_add_pd(vMult, vMult), vMask);
+        }
+
+        __m256d vNum = _mm256_mul_pd(bFundamental ? _mm256_mul_pd(vFreq, vMult) : vFreq, vPFDDen);
+
+        // INT = floor(num / den), corrected so 0 <= rem < den
+        __m256d vInt = _mm256_floor_pd(_mm256_div_pd(vNum, vDen));
+        __m256d vRem = _mm256_sub_pd(vNum, _mm256_mul_pd(vInt, vDen));
+        __m256d vLow = _mm256_cmp_pd(vRem, vZero, _CMP_LT_OQ);
+        vInt = _mm256_sub_pd(vInt, _mm256_and_pd(vLow, vOne));
+        vRem = _mm256_add_pd(vRem, _mm256_and_pd(vLow, vDen));
+        __m256d vHigh = _mm256_cmp_pd(vRem, vDen, _CMP_GE_OQ);
+        vInt = _mm256_add_pd(vInt, _mm256_and_pd(vHigh, vOne));
+        vRem = _mm256_sub_pd(vRem, _mm256_and_pd(vHigh, vDen));
+
+        // FRAC = floor((rem * 2 * MOD + den) / (2 * den)), corrected the same way
+        __m256d vFracNum = _mm256_add_pd(_mm256_mul_pd(vRem, vTwoMod), vDen);
+        __m256d vFrac = _mm256_floor_pd(_mm256_div_pd(vFracNum, vDen2));
+        __m256d vFracRem = _mm256_sub_pd(vFracNum, _mm256_mul_pd(vFrac, vDen2));
+        vFrac = _mm256_sub_pd(vFrac, _mm256_and_pd(_mm256_cmp_pd(vFracRem, vZero, _CMP_LT_OQ), vOne));
+        vFrac = _mm256_add_pd(vFrac, _mm256_and_pd(_mm256_cmp_pd(vFracRem, vDen2, _CMP_GE_OQ), vOne));
+
+        // Carry FRAC == MOD into INT
+        __m256d vCarry = _mm256_cmp_pd(vFrac, vMod, _CMP_EQ_OQ);
+        vInt = _mm256_add_pd(vInt, _mm256_and_pd(vCarry, vOne));
+        vFrac = _mm256_andnot_pd(vCarry, vFrac);
+
+        // Anything too large for INT is flagged by saturating it
+        vInt = _mm256_min_pd(vInt, _mm256_set1_pd(2147483647.0));
+
+        _mm_storeu_si128((__m128i *)&psBatch->pu32Int[n], _mm256_cvttpd_epi32(vInt));
+        _mm_storeu_si128((__m128i *)&psBatch->pu32Frac[n], _mm256_cvttpd_epi32(vFrac));
+        _mm_storeu_si128((__m128i *)&psBatch->pu32OutputDividerSelect[n], _mm256_cvttpd_epi32(vSelect));
+        for(int i = 0; i < 4; i++)
+        {
+            psBatch->pu32Mod[n + i] = (uint32_t)u64Mod;
+        }
+    }
+
+    return n;
+}
+#endif
+
+// Binary (Stein's) GCD, GCD(a, 0) = a
+static uint64_t ADF435x_u64GCD(uint64_t a, uint64_t b)
+{
+    int iShift;
+
+    if(a == 0)
+    {
+        return b;
+    }
+    if(b == 0)
+    {
+        return a;
+    }
+
+    iShift = ADF435x_iCountTrailingZeros(a | b);
+    a >>= ADF435x_iCountTrailingZeros(a);
+
+    do
+    {
+        b >>= ADF435x_iCountTrailingZeros(b);
+        if(a > b)
+        {
+            uint64_t t = a;
+            a = b;
+            b = t;
+        }
+        b -= a;
+    } while(b != 0);
+
+    return a << iShift;
+}
+
+// Best rational approximation u64Num / u64Den with a denominator no larger
+// than u64MaxDen, found by walking the continued fraction convergents and
+// checking the final semiconvergent. Takes at most ~log(u64MaxDen) steps.
+static void ADF435x_vBestFraction(uint64_t u64Num, uint64_t u64Den, uint64_t u64MaxDen, uint64_t *pu64Num, uint64_t *pu64Den)
+{
+    uint64_t p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+    uint64_t n = u64Num, d = u64Den;
+    uint64_t a, k, ps, qs, t;
+
+    while(d != 0)
+    {
+        a = n / d;
+        if(q0 + a * q1 > u64MaxDen)
+        {
+            break;
+        }
+
+        t = p0 + a * p1;
+        p0 = p1;
+        p1 = t;
+        t = q0 + a * q1;
+        q0 = q1;
+        q1 = t;
+
+        t = n - a * d;
+        n = d;
+        d = t;
+    }
+
+    if(d != 0)
+    {
+        // Largest semiconvergent that fits, take it if it is closer
+        k = (u64MaxDen - q0) / q1;
+        ps = p0 + k * p1;
+        qs = q0 + k * q1;
+
+        uint64_t u64ErrS = ps * u64Den > u64Num * qs ? ps * u64Den - u64Num * qs : u64Num * qs - ps * u64Den;
+        uint64_t u64Err1 = p1 * u64Den > u64Num * q1 ? p1 * u64Den - u64Num * q1 : u64Num * q1 - p1 * u64Den;
+
+        if(u64ErrS * q1 < u64Err1 * qs)
         {
-            b = fmod(b, a);
+            p1 = ps;
+            q1 = qs;
         }
     }
+
+    *pu64Num = p1;
+    *pu64Den = q1;
+}
+
+// Undefined for 0
+static int ADF435x_iCountTrailingZeros(uint64_t u64Val)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(u64Val);
+#else
+    int n = 0;
+
+    while((u64Val & 1) == 0)
+    {
+        u64Val >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Validates the options once and packs every register bit that depends only
+// on them. The INT, FRAC, MOD, LDF, output divider select and band select
+// clock divider fields are left clear for ADF435x_bGenerateRegisters(),
+// except that with a fixed MOD the LDF is held at its Frac-N setting so
+// that R2 does not change when FRAC happens to be 0.
+static bool ADF435x_bCompileOptions(ADF435x_tsContext *psContext)
+{
+    ADF435x_tsOptions *psOptions = &psContext->sOptions;
+    ADF435X_tuRegisters *puBase = &psContext->uBase;
+
+    bool bOk = true;
+
+    psContext->bCompiled = false;
+
+    bOk &= ADF435x_bCheckLookupVal(psContext, "ChargePumpCurrent", psOptions->fChargePumpCurrent, ADF435x_afChargePumpCurrent, sizeof(ADF435x_afChargePumpCurrent) / sizeof(float));
+    bOk &= ADF435x_bCheckLookupVal(psContext, "ABP", psOptions->fABP, ADF435x_afABP, sizeof(ADF435x_afABP) / sizeof(float));
+
+    if(psOptions->u32FixedMod != 0)
+    {
+        bOk &= ADF435x_bCheckUint(psContext, "Fixed MOD", psOptions->u32FixedMod, 4095);
+        if(psOptions->u32FixedMod < 2)
+        {
+            ADF435x_vSetError(psContext, "Fixed MOD must be at least 2.");
+            bOk = false;
+        }
+        if(psOptions->bBestFracMod)
+        {
+            ADF435x_vSetError(psContext, "Best approximation FRAC/MOD can not be used with a fixed MOD.");
+            bOk = false;
+        }
+    }
+
+    if(!bOk) return false;
+
+    // R0
+    puBase->u32Register0 = 0x0;
+
+    // R1
+    puBase->u32Register1 = (psOptions->u32PhaseValue != 0 ? 1 : 0) << 28 |
+                           (psOptions->ePrescaler == E_ADF435X_PRESCALER_8_OVER_9 ? 1 : 0) << 27 |
+                           (psOptions->u32PhaseValue == 0 ? 1 : 0) << 15 |
+                           0x1;
+
+    // R2
+    puBase->u32Register2 = (uint32_t)psOptions->eLowNoiseOrLowSpurMode << 29 |
+                           (uint32_t)psOptions->eMuxOut << 26 |
+                           (psOptions->bRefDoubler ? 1 : 0) << 25 |
+                           (psOptions->bRefDiv2 ? 1 : 0) << 24 |
+                           psOptions->u32RCounter << 14 |
+                           (psOptions->bDoubleBufR4 ? 1 : 0) << 13 |
+                           ADF435x_iLookupVal(psContext, psOptions->fChargePumpCurrent, ADF435x_afChargePumpCurrent, sizeof(ADF435x_afChargePumpCurrent) / sizeof(float)) << 9 |
+                           (psOptions->u32FixedMod != 0 ? 1 : 0) << 8 |
+                           (psOptions->fLDP == 10.0 ? 0 : 1) << 7 |
+                           (uint32_t)psOptions->ePDPolarity << 6 |
+                           (psOptions->bPowerDown ? 1 : 0) << 5 |
+                           (psOptions->bCPTristate ? 1 : 0) << 4 |
+                           (psOptions->bCounterReset ? 1 : 0) << 3 |
+                           0x2;
+
+    // R3
+    puBase->u32Register3 = (psOptions->bCSR ? 1 : 0) << 18 |
+                           (uint32_t)psOptions->eClockDivMode << 15 |
+                           psOptions->u32ClockDividerValue << 3 |
+                           0x3;
+
+    if(psOptions->eDeviceType == E_ADF435X_DEVICE_TYPE_ADF4351)
+    {
+        puBase->u32Register3 |= (uint32_t)psOptions->eBandSelectClockMode << 23 |
+                                ADF435x_iLookupVal(psContext, psOptions->fABP, ADF435x_afABP, sizeof(ADF435x_afABP) / sizeof(float)) << 22 |
+                                (psOptions->bChargeCancel ? 1 : 0) << 21;
+    }
+
+    // R4
+    puBase->u32Register4 = (uint32_t)psOptions->eFeedbackSelect << 23 |
+                           (psOptions->bVCOPowerDown ? 1 : 0) << 11 |
+                           (psOptions->bMuteTillLockDetect ? 1 : 0) << 10 |
+                           (uint32_t)psOptions->eAuxOutputSelect << 9 |
+                           (psOptions->bAuxOutputEnable ? 1 : 0) << 8 |
+                           (uint32_t)psOptions->eAuxOutputPower << 6 |
+                           (psOptions->bOutputEnable ? 1 : 0) << 5 |
+                           (uint32_t)psOptions->eOutputPower << 3 |
+                           0x4;
+
+    // R5
+    puBase->u32Register5 = (uint32_t)psOptions->eLDPinMode << 22 |
+                           3 << 19 |
+                           0x5;
+
+    psContext->bCompiled = true;
+
+    return true;
 }
 
-static bool ADF435x_bCheckUint(char *acName, uint32_t u32Val, uint32_t u32Max)
+static bool ADF435x_bCheckUint(ADF435x_tsContext *psContext, char *acName, uint32_t u32Val, uint32_t u32Max)
 {
     if(u32Val > u32Max)
     {
-        printf("%s must be an integer greater than or equal to 0, and less than %d, its currently %d\n", acName, u32Max, u32Val);
+        ADF435x_vSetError(psContext, "%s must be an integer greater than or equal to 0, and less than %d, its currently %d", acName, u32Max, u32Val);
         return false;
     }
     return true;
 }
 
-static bool ADF435x_bCheckLookupVal(char *acName, float fVal, float *pfArray, int iArrayLen)
+static bool ADF435x_bCheckLookupVal(ADF435x_tsContext *psContext, char *acName, float fVal, const float *pfArray, int iArrayLen)
 {
     for(int n = 0; n < iArrayLen; n++)
     {
@@ -348,12 +855,12 @@ static bool ADF435x_bCheckLookupVal(char *acName, float fVal, float *pfArray, in
         }
     }
 
-    printf("Value %s:%f is not in the array\n", acName, fVal);
+    ADF435x_vSetError(psContext, "Value %s:%f is not in the array", acName, fVal);
 
     return false;
 }
 
-static int ADF435x_iLookupVal(float fVal, float *pfArray, int iArrayLen)
+static int ADF435x_iLookupVal(ADF435x_tsContext *psContext, float fVal, const float *pfArray, int iArrayLen)
 {
     for(int n = 0; n < iArrayLen; n++)
     {
@@ -363,7 +870,7 @@ static int ADF435x_iLookupVal(float fVal, float *pfArray, int iArrayLen)
         }
     }
 
-    printf("Value %f is not in the array\n", fVal);
+    ADF435x_vSetError(psContext, "Value %f is not in the array", fVal);
 
     return 0;
 }
\ No newline at end of file
@@ -23,8 +23,12 @@
 #define _ADF4351_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Longest error message held in a context, including the terminator
+#define ADF435X_ERROR_LENGTH    (160)
+
 typedef enum{
 	E_ADF435X_VERBOSITY_LOW = 0,
 	E_ADF435X_VERBOSITY_MEDIUM = 1,
@@ -116,11 +120,15 @@ typedef struct {
     uint32_t u32PhaseValue;
     uint32_t u32ClockDividerValue;
 
+    // MOD used for every frequency, 0 to use the channel spacing
+    uint32_t u32FixedMod;
+
     float fChargePumpCurrent;
     float fLDP;
     float fABP;
 
     bool bEnableGCD;
+    bool bBestFracMod;
     bool bRefDoubler;
     bool bRefDiv2;
     bool bDoubleBufR4;
@@ -142,6 +150,7 @@ typedef struct {
     uint64_t u64Frac;
     uint64_t u64OutputDivider;
     uint64_t u64BandSelectClockDivider;
+    double dFrequencyErrorHz;
 } ADF435X_tsSettings;
 
 typedef union {
@@ -156,10 +165,56 @@ typedef union {
     uint32_t au32[6];
 } ADF435X_tuRegisters;
 
-void ADF435x_vInit(ADF435X_teVerbosity eVerbosity);
+// Struct of arrays for calculating many frequencies at once
+typedef struct {
+    size_t uCount;
+    uint32_t *pu32Int;
+    uint32_t *pu32Frac;
+    uint32_t *pu32Mod;
+    uint32_t *pu32OutputDividerSelect;
+    uint32_t *apu32Registers[6];
+
+    // Index of the first point that failed validation, uCount if none did
+    size_t uFirstInvalid;
+} ADF435X_tsSettingsBatch;
+
+// Everything needed to calculate settings for one synthesizer. Nothing is
+// shared between contexts, errors are reported through acError rather than
+// printed. The shadow of the registers last written is not kept here but in
+// ADF435X_DEV_tsDevice, next to the transport that writes them: a context
+// only calculates, and is copied to each sweep worker and shared with the
+// pipeline producer thread, so a shadow here would be duplicated or raced.
+typedef struct {
+    ADF435X_teVerbosity eVerbosity;
+    ADF435x_tsOptions sOptions;
+
+    // Derived from sOptions by ADF435x_bSetOptions()
+    uint64_t u64PFDNumerator;
+    uint64_t u64PFDDenominator;
+    uint64_t u64PFDFreqHz;
+    uint64_t u64ChannelMod;
+    uint64_t u64BandSelectClockDivider;
+    bool bReduceFracMod;
+
+    // Register bits that depend only on sOptions, valid if bCompiled
+    ADF435X_tuRegisters uBase;
+    bool bCompiled;
+
+    char acError[ADF435X_ERROR_LENGTH];
+} ADF435x_tsContext;
+
+bool ADF435x_bInitContext(ADF435x_tsContext *psContext, ADF435x_tsOptions *psOptions, ADF435X_teVerbosity eVerbosity);
+bool ADF435x_bSetOptions(ADF435x_tsContext *psContext, ADF435x_tsOptions *psOptions);
+void ADF435x_vSetError(ADF435x_tsContext *psContext, const char *pcFormat, ...);
+const char *ADF435x_pcGetError(ADF435x_tsContext *psContext);
 void ADF435x_vGetOptions(ADF435x_tsOptions *psOptions);
-bool ADF435x_bCalculateSettings(uint64_t u64Frequency, ADF435x_tsOptions *psOptions, ADF435X_tsSettings *psSettings);
-bool ADF435x_bGenerateRegisters(ADF435x_tsOptions *psOptions, ADF435X_tsSettings *psSettings, ADF435X_tuRegisters *puRegisters);
+bool ADF435x_bCalculateSettings(ADF435x_tsContext *psContext, uint64_t u64Frequency, ADF435X_tsSettings *psSettings);
+bool ADF435x_bGenerateRegisters(ADF435x_tsContext *psContext, ADF435X_tsSettings *psSettings, ADF435X_tuRegisters *puRegisters);
+
+bool ADF435x_bAllocBatch(ADF435X_tsSettingsBatch *psBatch, size_t uCount);
+void ADF435x_vFreeBatch(ADF435X_tsSettingsBatch *psBatch);
+bool ADF435x_bCalculateSettingsBatch(ADF435x_tsContext *psContext, const uint64_t *pu64Frequency, ADF435X_tsSettingsBatch *psBatch);
+bool ADF435x_bGenerateRegistersBatch(ADF435x_tsContext *psContext, ADF435X_tsSettingsBatch *psBatch);
 
 
 #endif // _ADF4351_H_
\ No newline at end of file
@@ -0,0 +1,325 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <string.h>
+#include "adf435x_dev.h"
+
+void ADF435x_DEV_vInit(ADF435X_DEV_tsDevice *psDevice, TRANSPORT_tsBackend *psTransport)
+{
+    memset(psDevice, 0, sizeof(ADF435X_DEV_tsDevice));
+    psDevice->psTransport = psTransport;
+}
+
+// Writes only the registers that differ from the shadow copy, highest first,
+// then R0 if the hop needs it. See ADF435x_DEV_uHopWords().
+bool ADF435x_DEV_bWriteRegisters(ADF435X_DEV_tsDevice *psDevice, ADF435X_tuRegisters *puRegisters)
+{
+    uint32_t au32Words[6];
+    unsigned int uCount;
+
+    psDevice->bPrepared = false;
+
+    if(psDevice->bShadowValid)
+    {
+        uCount = ADF435x_DEV_uHopWords(&psDevice->uShadow, puRegisters, au32Words);
+    }
+    else
+    {
+        // Unknown device state, program everything R5 to R0
+        for(uCount = 0; uCount < 6; uCount++)
+        {
+            au32Words[uCount] = puRegisters->au32[5 - uCount];
+        }
+    }
+
+    psDevice->u64WordsWritten += uCount;
+    psDevice->u64WordsSkipped += 6 - uCount;
+
+    if(uCount == 0)
+    {
+        return true;
+    }
+
+    if(!psDevice->psTransport->pfWrite(psDevice->psTransport, au32Words, uCount))
+    {
+        // Device state is now unknown
+        psDevice->bShadowValid = false;
+        return false;
+    }
+
+    psDevice->uShadow = *puRegisters;
+    psDevice->bShadowValid = true;
+
+    return true;
+}
+
+// Minimal write sequence to go from register set puFrom to puTo, returns the
+// number of words put in pu32Words (at most 6).
+//
+// R1 to R5 are written, highest first, only if they changed. An R0 write
+// starts VCO band selection, so R0 is only written when it changed or when
+// a double buffered field changed, as those only take effect on the next R0
+// write: MOD and phase in R1, the reference doubler, divide by 2, R counter
+// and charge pump current in R2, and with DB13 of R2 set, the R4 output
+// divider select. Everything else takes effect as soon as it is written.
+unsigned int ADF435x_DEV_uHopWords(const ADF435X_tuRegisters *puFrom, const ADF435X_tuRegisters *puTo, uint32_t *pu32Words)
+{
+    unsigned int uCount = 0;
+    bool bWriteR0 = puTo->u32Register0 != puFrom->u32Register0;
+
+    for(int n = 5; n > 0; n--)
+    {
+        if(puTo->au32[n] != puFrom->au32[n])
+        {
+            pu32Words[uCount++] = puTo->au32[n];
+        }
+    }
+
+    if((puTo->u32Register1 ^ puFrom->u32Register1) & ADF435X_DEV_R1_DOUBLE_BUFFERED)
+    {
+        bWriteR0 = true;
+    }
+    if((puTo->u32Register2 ^ puFrom->u32Register2) & ADF435X_DEV_R2_DOUBLE_BUFFERED)
+    {
+        bWriteR0 = true;
+    }
+    if((puTo->u32Register2 & ADF435X_DEV_R2_DOUBLE_BUFFER_R4) &&
+       ((puTo->u32Register4 ^ puFrom->u32Register4) & ADF435X_DEV_R4_DIVIDER_SELECT))
+    {
+        bWriteR0 = true;
+    }
+
+    if(bWriteR0)
+    {
+        pu32Words[uCount++] = puTo->u32Register0;
+    }
+
+    return uCount;
+}
+
+// True if writing pu32Words now leaves the output as it is until the next R0
+// write, so a hop can be sent ahead while the previous one is still dwelling.
+// That holds when every word other than R0 only changes double buffered
+// fields against the shadow copy.
+bool ADF435x_DEV_bBuffered(ADF435X_DEV_tsDevice *psDevice, const uint32_t *pu32Words, unsigned int uCount)
+{
+    ADF435X_tuRegisters *puShadow = &psDevice->uShadow;
+    uint32_t u32Buffered;
+    unsigned int uRegister;
+
+    if(!psDevice->bShadowValid)
+    {
+        return false;
+    }
+
+    for(unsigned int n = 0; n < uCount; n++)
+    {
+        uRegister = pu32Words[n] & 0x7;
+
+        switch(uRegister)
+        {
+        case 0:
+            u32Buffered = ~0U;
+            break;
+        case 1:
+            u32Buffered = ADF435X_DEV_R1_DOUBLE_BUFFERED;
+            break;
+        case 2:
+            u32Buffered = ADF435X_DEV_R2_DOUBLE_BUFFERED;
+            break;
+        case 4:
+            // R2 DB13 is not itself double buffered, so a hop that changes
+            // it has already been turned down
+            u32Buffered = (puShadow->u32Register2 & ADF435X_DEV_R2_DOUBLE_BUFFER_R4) ? ADF435X_DEV_R4_DIVIDER_SELECT : 0;
+            break;
+        case 3:
+        case 5:
+            u32Buffered = 0;
+            break;
+        default:
+            return false;
+        }
+
+        if((pu32Words[n] ^ puShadow->au32[uRegister]) & ~u32Buffered)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Writes a precomputed sequence of register words as is, keeping the shadow
+// copy up to date from the address bits of each word
+bool ADF435x_DEV_bWriteWords(ADF435X_DEV_tsDevice *psDevice, const uint32_t *pu32Words, unsigned int uCount)
+{
+    psDevice->bPrepared = false;
+
+    if(uCount == 0)
+    {
+        psDevice->u64WordsSkipped += 6;
+        return true;
+    }
+
+    psDevice->u64WordsWritten += uCount;
+    psDevice->u64WordsSkipped += 6 - uCount;
+
+    if(!psDevice->psTransport->pfWrite(psDevice->psTransport, pu32Words, uCount))
+    {
+        psDevice->bShadowValid = false;
+        return false;
+    }
+
+    for(unsigned int n = 0; n < uCount; n++)
+    {
+        psDevice->uShadow.au32[pu32Words[n] & 0x7] = pu32Words[n];
+    }
+
+    return true;
+}
+
+// First half of a two phase hop. Writes everything the hop needs except R0,
+// and stages R0 in the transport ready for ADF435x_DEV_bCommit(). Only the
+// double buffered fields wait for R0, anything else changes when prepared.
+bool ADF435x_DEV_bPrepare(ADF435X_DEV_tsDevice *psDevice, ADF435X_tuRegisters *puRegisters)
+{
+    uint32_t au32Words[6];
+    unsigned int uCount;
+    bool bAll = !psDevice->bShadowValid;
+
+    if(bAll)
+    {
+        for(uCount = 0; uCount < 6; uCount++)
+        {
+            au32Words[uCount] = puRegisters->au32[5 - uCount];
+        }
+    }
+    else
+    {
+        uCount = ADF435x_DEV_uHopWords(&psDevice->uShadow, puRegisters, au32Words);
+    }
+
+    if(!ADF435x_DEV_bPrepareWords(psDevice, au32Words, uCount))
+    {
+        return false;
+    }
+
+    psDevice->bPreparedAll = bAll;
+
+    return true;
+}
+
+// As ADF435x_DEV_bPrepare() for a precomputed sequence of words, R0 is only
+// staged if it is the last word
+bool ADF435x_DEV_bPrepareWords(ADF435X_DEV_tsDevice *psDevice, const uint32_t *pu32Words, unsigned int uCount)
+{
+    if(uCount == 0 || (pu32Words[uCount - 1] & 0x7) != 0)
+    {
+        return ADF435x_DEV_bWriteWords(psDevice, pu32Words, uCount);
+    }
+
+    if(uCount > 1 && !ADF435x_DEV_bWriteWords(psDevice, pu32Words, uCount - 1))
+    {
+        return false;
+    }
+
+    if(!psDevice->psTransport->pfPrepare(psDevice->psTransport, &pu32Words[uCount - 1], 1))
+    {
+        psDevice->bShadowValid = false;
+        return false;
+    }
+
+    psDevice->u32PreparedR0 = pu32Words[uCount - 1];
+    psDevice->bPrepared = true;
+    psDevice->bPreparedAll = false;
+
+    // The words before R0 were counted as a write of uCount - 1 words
+    psDevice->u64WordsWritten++;
+    if(uCount == 1)
+    {
+        psDevice->u64WordsSkipped += 5;
+    }
+    else
+    {
+        psDevice->u64WordsSkipped--;
+    }
+
+    return true;
+}
+
+// Second half of a two phase hop, sends the staged R0. Does nothing if the
+// prepared hop did not need R0.
+bool ADF435x_DEV_bCommit(ADF435X_DEV_tsDevice *psDevice)
+{
+    if(!psDevice->bPrepared)
+    {
+        return true;
+    }
+
+    psDevice->bPrepared = false;
+
+    if(!psDevice->psTransport->pfCommit(psDevice->psTransport))
+    {
+        psDevice->bShadowValid = false;
+        return false;
+    }
+
+    psDevice->uShadow.u32Register0 = psDevice->u32PreparedR0;
+    if(psDevice->bPreparedAll)
+    {
+        psDevice->bShadowValid = true;
+    }
+
+    return true;
+}
+
+// Polls the lock detect signal until it is asserted or u64TimeoutNs has
+// passed. Returns false on timeout or if the signal could not be read. The
+// MUXOUT (or LD) pin must be set to digital lock detect.
+bool ADF435x_DEV_bWaitLock(ADF435X_DEV_tsDevice *psDevice, uint64_t u64TimeoutNs)
+{
+    uint64_t u64StartNs = TRANSPORT_u64TimeNs();
+    uint64_t u64ElapsedNs;
+    bool bLocked = false;
+
+    do
+    {
+        if(!psDevice->psTransport->pfLockDetect(psDevice->psTransport, &bLocked))
+        {
+            return false;
+        }
+        u64ElapsedNs = TRANSPORT_u64TimeNs() - u64StartNs;
+    } while(!bLocked && u64ElapsedNs < u64TimeoutNs);
+
+    psDevice->u64LockWaits++;
+    psDevice->u64LockWaitNs += u64ElapsedNs;
+    if(u64ElapsedNs > psDevice->u64MaxLockWaitNs)
+    {
+        psDevice->u64MaxLockWaitNs = u64ElapsedNs;
+    }
+
+    if(!bLocked)
+    {
+        psDevice->u64LockTimeouts++;
+    }
+
+    return bLocked;
+}
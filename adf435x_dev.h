@@ -0,0 +1,69 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _ADF435X_DEV_H_
+#define _ADF435X_DEV_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "adf435x.h"
+#include "transport.h"
+
+// Register fields that only take effect on the next write to R0
+#define ADF435X_DEV_R1_DOUBLE_BUFFERED      ((0xfffU << 15) | (0xfffU << 3))
+#define ADF435X_DEV_R2_DOUBLE_BUFFERED      ((1U << 25) | (1U << 24) | (0x3ffU << 14) | (0xfU << 9))
+#define ADF435X_DEV_R2_DOUBLE_BUFFER_R4     (1U << 13)
+#define ADF435X_DEV_R4_DIVIDER_SELECT       (0x7U << 20)
+
+typedef struct {
+    TRANSPORT_tsBackend *psTransport;
+
+    // Last register values written to the device
+    ADF435X_tuRegisters uShadow;
+    bool bShadowValid;
+
+    // R0 staged by ADF435x_DEV_bPrepare() until ADF435x_DEV_bCommit(), and
+    // whether that completes a write of every register
+    uint32_t u32PreparedR0;
+    bool bPrepared;
+    bool bPreparedAll;
+
+    uint64_t u64WordsWritten;
+    uint64_t u64WordsSkipped;
+
+    // Lock detect polling
+    uint64_t u64LockWaits;
+    uint64_t u64LockTimeouts;
+    uint64_t u64LockWaitNs;
+    uint64_t u64MaxLockWaitNs;
+} ADF435X_DEV_tsDevice;
+
+void ADF435x_DEV_vInit(ADF435X_DEV_tsDevice *psDevice, TRANSPORT_tsBackend *psTransport);
+bool ADF435x_DEV_bWriteRegisters(ADF435X_DEV_tsDevice *psDevice, ADF435X_tuRegisters *puRegisters);
+unsigned int ADF435x_DEV_uHopWords(const ADF435X_tuRegisters *puFrom, const ADF435X_tuRegisters *puTo, uint32_t *pu32Words);
+bool ADF435x_DEV_bBuffered(ADF435X_DEV_tsDevice *psDevice, const uint32_t *pu32Words, unsigned int uCount);
+bool ADF435x_DEV_bWriteWords(ADF435X_DEV_tsDevice *psDevice, const uint32_t *pu32Words, unsigned int uCount);
+bool ADF435x_DEV_bPrepare(ADF435X_DEV_tsDevice *psDevice, ADF435X_tuRegisters *puRegisters);
+bool ADF435x_DEV_bPrepareWords(ADF435X_DEV_tsDevice *psDevice, const uint32_t *pu32Words, unsigned int uCount);
+bool ADF435x_DEV_bCommit(ADF435X_DEV_tsDevice *psDevice);
+bool ADF435x_DEV_bWaitLock(ADF435X_DEV_tsDevice *psDevice, uint64_t u64TimeoutNs);
+
+#endif // _ADF435X_DEV_H_
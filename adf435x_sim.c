@@ -0,0 +1,208 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "adf435x_sim.h"
+
+static void ADF435x_SIM_vLatch(ADF435X_SIM_tsDevice *psSim, uint32_t u32Word, uint64_t u64TimeNs);
+static void ADF435x_SIM_vDecode(ADF435X_SIM_tsDevice *psSim);
+
+// Simulated ADF435x fed from the mock transport. It shifts in the SPI bytes,
+// latches the last 32 bits on the rising edge of LE and decodes the register
+// set back into the synthesizer settings.
+void ADF435x_SIM_vInit(ADF435X_SIM_tsDevice *psSim, uint64_t u64ReferenceFrequencyHz)
+{
+    memset(psSim, 0, sizeof(ADF435X_SIM_tsDevice));
+    psSim->u64ReferenceFrequencyHz = u64ReferenceFrequencyHz;
+    psSim->u64SettleNs = ADF435X_SIM_DEFAULT_SETTLE_NS;
+}
+
+void ADF435x_SIM_vAttach(ADF435X_SIM_tsDevice *psSim, TRANSPORT_tsMock *psMock)
+{
+    psMock->pfListener = ADF435x_SIM_vOnEvent;
+    psMock->pvUser = psSim;
+    psMock->pfLockDetect = ADF435x_SIM_bMuxOut;
+}
+
+void ADF435x_SIM_vOnEvent(void *pvUser, const TRANSPORT_tsMockEvent *psEvent)
+{
+    ADF435X_SIM_tsDevice *psSim = pvUser;
+
+    switch(psEvent->u8Type)
+    {
+    case TRANSPORT_MOCK_EVENT_CS_ASSERT:
+        psSim->uBits = 0;
+        break;
+
+    case TRANSPORT_MOCK_EVENT_BYTE:
+        psSim->u32Shift = (psSim->u32Shift << 8) | psEvent->u8Byte;
+        psSim->uBits += 8;
+        break;
+
+    case TRANSPORT_MOCK_EVENT_CS_DEASSERT:
+        if(psSim->uBits >= 32)
+        {
+            ADF435x_SIM_vLatch(psSim, psSim->u32Shift, psEvent->u64TimeNs);
+        }
+        psSim->uBits = 0;
+        break;
+    }
+}
+
+// Marks the time a new frequency was requested, for command to lock latency
+void ADF435x_SIM_vCommand(ADF435X_SIM_tsDevice *psSim)
+{
+    psSim->u64CommandNs = TRANSPORT_u64TimeNs();
+}
+
+bool ADF435x_SIM_bIsLocked(ADF435X_SIM_tsDevice *psSim, uint64_t u64TimeNs)
+{
+    return psSim->u64Locks != 0 && u64TimeNs >= psSim->u64LockedNs;
+}
+
+// Level of the MUXOUT pin, which only follows lock when set to digital lock
+// detect
+bool ADF435x_SIM_bMuxOut(void *pvUser, uint64_t u64TimeNs)
+{
+    ADF435X_SIM_tsDevice *psSim = pvUser;
+
+    switch(psSim->sDecoded.eMuxOut)
+    {
+    case E_ADF435X_MUX_OUT_DVDD:
+        return true;
+
+    case E_ADF435X_MUX_OUT_DIGITAL_LOCK_DETECT:
+        return ADF435x_SIM_bIsLocked(psSim, u64TimeNs);
+
+    default:
+        return false;
+    }
+}
+
+static void ADF435x_SIM_vLatch(ADF435X_SIM_tsDevice *psSim, uint32_t u32Word, uint64_t u64TimeNs)
+{
+    uint32_t u32Address = u32Word & 0x7;
+    uint64_t u64PFDFreqHz;
+    uint64_t u64BandSelectNs;
+    uint64_t u64LatencyNs;
+
+    if(u32Address > 5)
+    {
+        return;
+    }
+
+    psSim->u64Words++;
+
+    // With double buffering enabled the R4 output divider select only takes
+    // effect on the next write to R0
+    if(u32Address == 4 && (psSim->uRegisters.u32Register2 & (1 << 13)))
+    {
+        psSim->uRegisters.u32Register4 = (psSim->uRegisters.u32Register4 & (0x7 << 20)) | (u32Word & ~(0x7 << 20));
+        psSim->u32PendingR4 = u32Word;
+        psSim->bPendingR4 = true;
+    }
+    else
+    {
+        psSim->uRegisters.au32[u32Address] = u32Word;
+        if(u32Address == 4)
+        {
+            psSim->bPendingR4 = false;
+        }
+    }
+
+    psSim->u8Written |= 1 << u32Address;
+
+    if(u32Address != 0)
+    {
+        ADF435x_SIM_vDecode(psSim);
+        return;
+    }
+
+    if(psSim->bPendingR4)
+    {
+        psSim->uRegisters.u32Register4 = psSim->u32PendingR4;
+        psSim->bPendingR4 = false;
+    }
+
+    ADF435x_SIM_vDecode(psSim);
+
+    // Writing R0 starts VCO band selection, which takes 10 cycles of the band
+    // select clock, after which the loop settles
+    u64PFDFreqHz = (psSim->u64ReferenceFrequencyHz * (psSim->sDecoded.bRefDoubler ? 2 : 1)) /
+                   ((psSim->sDecoded.bRefDiv2 ? 2 : 1) * (psSim->sDecoded.u32RCounter ? psSim->sDecoded.u32RCounter : 1));
+
+    u64BandSelectNs = u64PFDFreqHz ? (10ULL * psSim->sDecoded.u32BandSelectClockDivider * 1000000000ULL) / u64PFDFreqHz : 0;
+
+    psSim->u64LockedNs = u64TimeNs + u64BandSelectNs + psSim->u64SettleNs;
+    psSim->dOutputFrequencyHz = 0;
+
+    if(psSim->sDecoded.u32Mod && psSim->sDecoded.u32OutputDivider)
+    {
+        double dN = psSim->sDecoded.u32Int + (double)psSim->sDecoded.u32Frac / psSim->sDecoded.u32Mod;
+
+        if(psSim->sDecoded.bFeedbackFundamental)
+        {
+            psSim->dOutputFrequencyHz = u64PFDFreqHz * dN / psSim->sDecoded.u32OutputDivider;
+        }
+        else
+        {
+            psSim->dOutputFrequencyHz = u64PFDFreqHz * dN;
+        }
+    }
+
+    if(psSim->u64CommandNs)
+    {
+        u64LatencyNs = psSim->u64LockedNs - psSim->u64CommandNs;
+        psSim->u64TotalLatencyNs += u64LatencyNs;
+        if(u64LatencyNs > psSim->u64MaxLatencyNs)
+        {
+            psSim->u64MaxLatencyNs = u64LatencyNs;
+        }
+        psSim->u64CommandNs = 0;
+    }
+
+    psSim->u64Locks++;
+}
+
+static void ADF435x_SIM_vDecode(ADF435X_SIM_tsDevice *psSim)
+{
+    ADF435X_tuRegisters *puRegisters = &psSim->uRegisters;
+    ADF435X_SIM_tsDecoded *psDecoded = &psSim->sDecoded;
+
+    psDecoded->u32Int = (puRegisters->u32Register0 >> 15) & 0xffff;
+    psDecoded->u32Frac = (puRegisters->u32Register0 >> 3) & 0xfff;
+
+    psDecoded->u32Mod = (puRegisters->u32Register1 >> 3) & 0xfff;
+    psDecoded->bPrescaler8Over9 = (puRegisters->u32Register1 >> 27) & 0x1;
+
+    psDecoded->u32RCounter = (puRegisters->u32Register2 >> 14) & 0x3ff;
+    psDecoded->bRefDoubler = (puRegisters->u32Register2 >> 25) & 0x1;
+    psDecoded->bRefDiv2 = (puRegisters->u32Register2 >> 24) & 0x1;
+    psDecoded->bDoubleBufR4 = (puRegisters->u32Register2 >> 13) & 0x1;
+    psDecoded->eMuxOut = (puRegisters->u32Register2 >> 26) & 0x7;
+
+    psDecoded->bFeedbackFundamental = (puRegisters->u32Register4 >> 23) & 0x1;
+    psDecoded->u32OutputDivider = 1 << ((puRegisters->u32Register4 >> 20) & 0x7);
+    psDecoded->u32BandSelectClockDivider = (puRegisters->u32Register4 >> 12) & 0xff;
+    psDecoded->bOutputEnable = (puRegisters->u32Register4 >> 5) & 0x1;
+    psDecoded->u32OutputPower = (puRegisters->u32Register4 >> 3) & 0x3;
+}
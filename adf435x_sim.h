@@ -0,0 +1,82 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _ADF435X_SIM_H_
+#define _ADF435X_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "adf435x.h"
+#include "transport.h"
+
+// Default PLL settling time after VCO band selection completes
+#define ADF435X_SIM_DEFAULT_SETTLE_NS   (20000)
+
+typedef struct {
+    uint32_t u32Int;
+    uint32_t u32Frac;
+    uint32_t u32Mod;
+    uint32_t u32RCounter;
+    uint32_t u32OutputDivider;
+    uint32_t u32BandSelectClockDivider;
+    uint32_t u32OutputPower;
+    ADF435X_teMuxOut eMuxOut;
+    bool bPrescaler8Over9;
+    bool bRefDoubler;
+    bool bRefDiv2;
+    bool bDoubleBufR4;
+    bool bFeedbackFundamental;
+    bool bOutputEnable;
+} ADF435X_SIM_tsDecoded;
+
+typedef struct {
+    // Configuration, not visible on the SPI bus
+    uint64_t u64ReferenceFrequencyHz;
+    uint64_t u64SettleNs;
+
+    // Shift register and latched registers
+    uint32_t u32Shift;
+    unsigned int uBits;
+    ADF435X_tuRegisters uRegisters;
+    uint32_t u32PendingR4;
+    bool bPendingR4;
+    uint8_t u8Written;
+
+    ADF435X_SIM_tsDecoded sDecoded;
+    double dOutputFrequencyHz;
+
+    // Lock timing
+    uint64_t u64CommandNs;
+    uint64_t u64LockedNs;
+    uint64_t u64Locks;
+    uint64_t u64TotalLatencyNs;
+    uint64_t u64MaxLatencyNs;
+    uint64_t u64Words;
+} ADF435X_SIM_tsDevice;
+
+void ADF435x_SIM_vInit(ADF435X_SIM_tsDevice *psSim, uint64_t u64ReferenceFrequencyHz);
+void ADF435x_SIM_vAttach(ADF435X_SIM_tsDevice *psSim, TRANSPORT_tsMock *psMock);
+void ADF435x_SIM_vOnEvent(void *pvUser, const TRANSPORT_tsMockEvent *psEvent);
+void ADF435x_SIM_vCommand(ADF435X_SIM_tsDevice *psSim);
+bool ADF435x_SIM_bIsLocked(ADF435X_SIM_tsDevice *psSim, uint64_t u64TimeNs);
+bool ADF435x_SIM_bMuxOut(void *pvUser, uint64_t u64TimeNs);
+
+#endif // _ADF435X_SIM_H_
@@ -10,6 +10,7 @@
 
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "libusb.h"
@@ -52,14 +53,104 @@ const unsigned char BitSwapTable[256] =
 	0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
 };
 
-static struct libusb_device_handle *CH341DeviceHanlde;
+/*
+ * Every USB transfer, synchronous or not, goes through a libusb_transfer from
+ * a fixed pool allocated when the device is opened, so a steady state sweep
+ * makes no heap allocations. Entry 0 is used by the blocking path, the rest
+ * are the asynchronous queue. The drain transfers read back the write-only
+ * backlog, one per pending SPI packet.
+ */
+struct ch341_transfer
+{
+	struct libusb_transfer *transfer;
+	unsigned char buffer[CH341_WORDS_STREAM_LENGTH(CH341_MAX_WORDS)];
+	bool busy;
+};
+
+struct ch341_device
+{
+	struct libusb_device_handle *handle;
+	struct ch341_transfer pool[1 + CH341_MAX_ASYNC_DEPTH];
+	struct libusb_transfer *reader;
+	struct libusb_transfer *drain[CH341_MAX_PENDING_PACKETS];
+	unsigned long allocations;
+};
+
+static struct ch341_device CH341Device;
+
+static void CH341FreeTransfers(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < 1 + CH341_MAX_ASYNC_DEPTH; i++)
+	{
+		libusb_free_transfer(CH341Device.pool[i].transfer);
+		CH341Device.pool[i].transfer = NULL;
+		CH341Device.pool[i].busy = false;
+	}
+
+	libusb_free_transfer(CH341Device.reader);
+	CH341Device.reader = NULL;
+
+	for (i = 0; i < CH341_MAX_PENDING_PACKETS; i++)
+	{
+		libusb_free_transfer(CH341Device.drain[i]);
+		CH341Device.drain[i] = NULL;
+	}
+}
+
+static bool CH341AllocTransfers(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < 1 + CH341_MAX_ASYNC_DEPTH; i++)
+	{
+		if (!(CH341Device.pool[i].transfer = libusb_alloc_transfer(0)))
+			goto cleanup;
+
+		CH341Device.allocations++;
+	}
+
+	if (!(CH341Device.reader = libusb_alloc_transfer(0)))
+		goto cleanup;
+
+	CH341Device.allocations++;
+
+	for (i = 0; i < CH341_MAX_PENDING_PACKETS; i++)
+	{
+		if (!(CH341Device.drain[i] = libusb_alloc_transfer(0)))
+			goto cleanup;
+
+		CH341Device.allocations++;
+	}
+
+	return true;
+
+cleanup:
+	fprintf(stderr, "Error: failed to allocate USB transfers\n");
+	CH341FreeTransfers();
+	return false;
+}
+
+unsigned long CH341TransferAllocations(void)
+{
+	return CH341Device.allocations;
+}
+
+/* Write-only mode: SPI readback still queued on the IN endpoint */
+static unsigned int CH341PendingPackets;
+static unsigned int CH341PendingHops;
+static unsigned int CH341DrainHops;
+static unsigned int CH341DrainOutstanding;
+static bool CH341DrainFailed;
+static unsigned char CH341DrainBuffer[CH341_MAX_PENDING_PACKETS * (CH341_PACKET_LENGTH - 1)];
 
 bool CH341DeviceInit(void)
 {
 	int ret;
 	unsigned char desc[0x12];
 
-	if (CH341DeviceHanlde)
+	if (CH341Device.handle)
 		return true;
 
 	if ((ret = libusb_init(NULL)))
@@ -68,16 +159,16 @@ bool CH341DeviceInit(void)
 		return false;
 	}
 
-	if (!(CH341DeviceHanlde = libusb_open_device_with_vid_pid(NULL, CH341_USB_VID, CH341_USB_PID)))
+	if (!(CH341Device.handle = libusb_open_device_with_vid_pid(NULL, CH341_USB_VID, CH341_USB_PID)))
 	{
 		fprintf(stderr, "Error: CH341 device (%04x/%04x) not found\n", CH341_USB_VID, CH341_USB_PID);
 		return false;
 	}
 
 #if !defined(_MSC_VER) && !defined(MSYS) && !defined(CYGWIN) && !defined(WIN32) && !defined(MINGW) && !defined(MINGW32)
-	if (libusb_kernel_driver_active(CH341DeviceHanlde, 0))
+	if (libusb_kernel_driver_active(CH341Device.handle, 0))
 	{
-		if ((ret = libusb_detach_kernel_driver(CH341DeviceHanlde, 0)))
+		if ((ret = libusb_detach_kernel_driver(CH341Device.handle, 0)))
 		{
 			fprintf(stderr, "Error: libusb_detach_kernel_driver failed: %d (%s)\n", ret, libusb_error_name(ret));
 			goto cleanup;
@@ -85,7 +176,7 @@ bool CH341DeviceInit(void)
 	}
 #endif
 
-	if ((ret = libusb_claim_interface(CH341DeviceHanlde, 0)))
+	if ((ret = libusb_claim_interface(CH341Device.handle, 0)))
 	{
 		printf("%s:%d\n", __FILE__, __LINE__);
 
@@ -93,7 +184,7 @@ bool CH341DeviceInit(void)
 		goto cleanup;
 	}
 
-	if (!(ret = libusb_get_descriptor(CH341DeviceHanlde, LIBUSB_DT_DEVICE, 0x00, desc, 0x12)))
+	if (!(ret = libusb_get_descriptor(CH341Device.handle, LIBUSB_DT_DEVICE, 0x00, desc, 0x12)))
 	{
 		printf("%s:%d\n", __FILE__, __LINE__);
 
@@ -102,42 +193,77 @@ bool CH341DeviceInit(void)
 
 	printf("CH341 %d.%02d found.\n\n", desc[12], desc[13]);
 
+	if (!CH341AllocTransfers())
+		goto cleanup;
+
 	return true;
 
 cleanup:
 	printf("%s:%d\n", __FILE__, __LINE__);
 
-	libusb_close(CH341DeviceHanlde);
-	CH341DeviceHanlde = NULL;
+	libusb_close(CH341Device.handle);
+	CH341Device.handle = NULL;
 	return false;
 }
 
 void CH341DeviceRelease(void)
 {
-	if (!CH341DeviceHanlde)
+	if (!CH341Device.handle)
 		return;
 
-	libusb_release_interface(CH341DeviceHanlde, 0);
-	libusb_close(CH341DeviceHanlde);
+	CH341AsyncRelease();
+
+	libusb_release_interface(CH341Device.handle, 0);
+	CH341FreeTransfers();
+	libusb_close(CH341Device.handle);
 	libusb_exit(NULL);
 
-	CH341DeviceHanlde = NULL;
+	CH341Device.handle = NULL;
+}
+
+static void LIBUSB_CALL CH341USBTransferDone(struct libusb_transfer *transfer)
+{
+	*(int *)transfer->user_data = 1;
 }
 
+/* Equivalent of libusb_bulk_transfer() using the pooled transfer */
 static int CH341USBTransferPart(enum libusb_endpoint_direction dir, unsigned char *buff, unsigned int size)
 {
-	int ret, bytestransferred;
+	struct libusb_transfer *transfer = CH341Device.pool[0].transfer;
+	int ret, completed = 0;
 
-	if (!CH341DeviceHanlde)
+	if (!CH341Device.handle)
 		return 0;
 
-	if ((ret = libusb_bulk_transfer(CH341DeviceHanlde, CH341_USB_BULK_ENDPOINT | dir, buff, size, &bytestransferred, CH341_USB_TIMEOUT)))
+	libusb_fill_bulk_transfer(transfer, CH341Device.handle, CH341_USB_BULK_ENDPOINT | dir, buff, size, CH341USBTransferDone, &completed, CH341_USB_TIMEOUT);
+
+	if ((ret = libusb_submit_transfer(transfer)))
+	{
+		fprintf(stderr, "Error: libusb_submit_transfer failed: %d (%s)\n", ret, libusb_error_name(ret));
+		return -1;
+	}
+
+	while (!completed)
+	{
+		if ((ret = libusb_handle_events_completed(NULL, &completed)))
+		{
+			if (ret == LIBUSB_ERROR_INTERRUPTED)
+				continue;
+
+			libusb_cancel_transfer(transfer);
+			while (!completed)
+				libusb_handle_events_completed(NULL, &completed);
+			break;
+		}
+	}
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED)
 	{
-		fprintf(stderr, "Error: libusb_bulk_transfer for IN_EP failed: %d (%s)\n", ret, libusb_error_name(ret));
+		fprintf(stderr, "Error: bulk transfer for %s failed: %d\n", dir == LIBUSB_ENDPOINT_IN ? "IN_EP" : "OUT_EP", transfer->status);
 		return -1;
 	}
 
-	return bytestransferred;
+	return transfer->actual_length;
 }
 
 static bool CH341USBTransfer(enum libusb_endpoint_direction dir, unsigned char *buff, unsigned int size)
@@ -163,20 +289,105 @@ static bool CH341USBTransfer(enum libusb_endpoint_direction dir, unsigned char *
 #define CH341USBRead(buff, size) CH341USBTransfer(LIBUSB_ENDPOINT_IN, buff, size)
 #define CH341USBWrite(buff, size) CH341USBTransfer(LIBUSB_ENDPOINT_OUT, buff, size)
 
+/*
+ * Every SPI stream packet makes the CH341 queue the bytes it clocked in on
+ * the IN endpoint. The ADF435x has nothing to read back, so in write-only
+ * mode that data is left queued and drained in one go every CH341DrainHops
+ * hops, rather than costing an IN transfer per write. A hop is one call that
+ * writes a set of words, however many words the shadow registers left in it.
+ * The drain comes sooner if the next hop could take the backlog past
+ * CH341_MAX_PENDING_PACKETS packets.
+ */
+void CH341SetWriteOnly(unsigned int drain_hops)
+{
+	CH341DrainHops = drain_hops;
+}
+
+static void LIBUSB_CALL CH341DrainDone(struct libusb_transfer *transfer)
+{
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED || transfer->actual_length != transfer->length)
+		CH341DrainFailed = true;
 
+	CH341DrainOutstanding--;
+}
 
-bool CH341ChipSelect(unsigned int cs, bool enable)
+/*
+ * The CH341 returns the readback of each SPI packet as a short USB packet of
+ * its own, and a short packet ends a bulk IN transfer, so no single request
+ * can take the whole backlog. Instead an IN transfer is posted for every
+ * pending packet before waiting on any of them. The host controller then
+ * collects the lot back to back and the drain costs one wait, not one round
+ * trip per packet as reading them in turn would.
+ */
+bool CH341FlushSPI(void)
 {
-	unsigned char pkt[4];
+	unsigned int packets = CH341PendingPackets;
+	unsigned int i;
+	int ret = 0;
 
-	static const int csio[4] = {0x36, 0x35, 0x33, 0x27};
+	CH341PendingPackets = 0;
+	CH341PendingHops = 0;
 
-	if (cs > 3)
+	if (!packets)
+		return true;
+
+	CH341DrainFailed = false;
+
+	for (i = 0; i < packets; i++)
 	{
-		fprintf(stderr, "Error: invalid CS pin %d, 0~3 are available\n", cs);
+		libusb_fill_bulk_transfer(CH341Device.drain[i], CH341Device.handle, CH341_USB_BULK_ENDPOINT | LIBUSB_ENDPOINT_IN,
+			&CH341DrainBuffer[i * (CH341_PACKET_LENGTH - 1)], CH341_PACKET_LENGTH - 1, CH341DrainDone, NULL, CH341_USB_TIMEOUT);
+
+		if ((ret = libusb_submit_transfer(CH341Device.drain[i])))
+		{
+			fprintf(stderr, "Error: libusb_submit_transfer for IN_EP failed: %d (%s)\n", ret, libusb_error_name(ret));
+			CH341DrainFailed = true;
+			break;
+		}
+
+		CH341DrainOutstanding++;
+	}
+
+	while (CH341DrainOutstanding)
+	{
+		if ((ret = libusb_handle_events_completed(NULL, NULL)) && ret != LIBUSB_ERROR_INTERRUPTED)
+		{
+			for (i = 0; i < packets; i++)
+				libusb_cancel_transfer(CH341Device.drain[i]);
+
+			while (CH341DrainOutstanding)
+				libusb_handle_events_completed(NULL, NULL);
+
+			CH341DrainFailed = true;
+		}
+	}
+
+	if (CH341DrainFailed)
+	{
+		fprintf(stderr, "Error: failed to drain data from CH341\n");
 		return false;
 	}
 
+	return true;
+}
+
+static bool CH341CompleteSPI(unsigned int packets)
+{
+	CH341PendingPackets += packets;
+	CH341PendingHops++;
+
+	if (CH341PendingHops < CH341DrainHops && CH341PendingPackets + CH341_MAX_WORDS <= CH341_MAX_PENDING_PACKETS)
+		return true;
+
+	return CH341FlushSPI();
+}
+
+
+
+static const int csio[4] = {0x36, 0x35, 0x33, 0x27};
+
+static unsigned int CH341BuildChipSelect(unsigned char *pkt, unsigned int cs, bool enable)
+{
 	pkt[0] = CH341_CMD_UIO_STREAM;
 	if (enable)
 		pkt[1] = CH341_CMD_UIO_STM_OUT | csio[cs];
@@ -185,7 +396,20 @@ bool CH341ChipSelect(unsigned int cs, bool enable)
 	pkt[2] = CH341_CMD_UIO_STM_DIR | 0x3F;
 	pkt[3] = CH341_CMD_UIO_STM_END;
 
-	return CH341USBWrite(pkt, 4);
+	return 4;
+}
+
+bool CH341ChipSelect(unsigned int cs, bool enable)
+{
+	unsigned char pkt[4];
+
+	if (cs > 3)
+	{
+		fprintf(stderr, "Error: invalid CS pin %d, 0~3 are available\n", cs);
+		return false;
+	}
+
+	return CH341USBWrite(pkt, CH341BuildChipSelect(pkt, cs, enable));
 }
 
 static int CH341TransferSPI(const unsigned char *in, unsigned char *out, unsigned int size)
@@ -196,6 +420,9 @@ static int CH341TransferSPI(const unsigned char *in, unsigned char *out, unsigne
 	if (!size)
 		return 0;
 
+	if (!CH341FlushSPI())
+		return -1;
+
 	if (size > CH341_PACKET_LENGTH - 1)
 		size = CH341_PACKET_LENGTH - 1;
 
@@ -293,4 +520,394 @@ bool CH341WriteSPI(const unsigned char *in, unsigned int size)
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+/*
+ * Compile a list of 32 bit SPI words into one contiguous stream of CH341
+ * packets, each word latched by its own CS pulse:
+ *
+ *   [UIO CS assert] [SPI w0] [UIO CS deassert + assert] [SPI w1] ... [UIO CS deassert]
+ *
+ * Words are sent MSB first in the order given. The CH341 takes everything after
+ * an SPI command to the end of its 32 byte packet as SPI data, so a word cannot
+ * share a packet with the UIO commands around it, and a short SPI packet would
+ * end the transfer. Each SPI packet is therefore full length with the word
+ * right aligned: 27 zero bytes are clocked out ahead of every word, where a
+ * separate CH341WriteSPI() of the word clocks only its 4 bytes. The ADF435x
+ * latches the last 32 bits shifted in when LE rises, so the leading zeros fall
+ * off the far end of its shift register and the latched words are the same.
+ * Each word costs 248 clocks instead of 32.
+ */
+unsigned int CH341BuildSPIWords(unsigned char *stream, unsigned int cs, const uint32_t *words, unsigned int count)
+{
+	unsigned char *pkt = stream;
+	unsigned int i, n;
+
+	memset(stream, 0, CH341_WORDS_STREAM_LENGTH(count));
+
+	CH341BuildChipSelect(pkt, cs, true);
+	pkt += CH341_PACKET_LENGTH;
+
+	for (n = 0; n < count; n++)
+	{
+		pkt[0] = CH341_CMD_SPI_STREAM;
+		for (i = 0; i < 4; i++)
+			pkt[CH341_PACKET_LENGTH - 4 + i] = BitSwapTable[(words[n] >> (24 - 8 * i)) & 0xff];
+		pkt += CH341_PACKET_LENGTH;
+
+		pkt[0] = CH341_CMD_UIO_STREAM;
+		pkt[1] = CH341_CMD_UIO_STM_OUT | 0x37;
+		pkt[2] = CH341_CMD_UIO_STM_DIR | 0x3F;
+
+		if (n == count - 1)
+		{
+			pkt[3] = CH341_CMD_UIO_STM_END;
+			pkt += 4;
+		}
+		else
+		{
+			pkt[3] = CH341_CMD_UIO_STM_OUT | csio[cs];
+			pkt[4] = CH341_CMD_UIO_STM_END;
+			pkt += CH341_PACKET_LENGTH;
+		}
+	}
+
+	return pkt - stream;
+}
+
+bool CH341WriteSPIWords(unsigned int cs, const uint32_t *words, unsigned int count)
+{
+	unsigned char stream[CH341_WORDS_STREAM_LENGTH(CH341_MAX_WORDS)];
+
+	if (!count)
+		return true;
+
+	if (cs > 3)
+	{
+		fprintf(stderr, "Error: invalid CS pin %d, 0~3 are available\n", cs);
+		return false;
+	}
+
+	if (count > CH341_MAX_WORDS)
+	{
+		fprintf(stderr, "Error: %u SPI words requested, %d is the maximum\n", count, CH341_MAX_WORDS);
+		return false;
+	}
+
+	if (!CH341USBWrite(stream, CH341BuildSPIWords(stream, cs, words, count)))
+	{
+		fprintf(stderr, "Error: failed to transfer words to CH341\n");
+		return false;
+	}
+
+	/* One full SPI packet comes back for each word */
+	return CH341CompleteSPI(count);
+}
+
+/*
+ * Asynchronous transport. Up to CH341AsyncDepth word streams are kept in
+ * flight on the OUT endpoint using transfers from the device pool, so the caller only
+ * blocks when the queue is full. A single IN transfer is kept posted and
+ * resubmitted from its callback to soak up the SPI readback as it arrives.
+ * Errors from completed transfers are latched and reported by the next
+ * submit or flush.
+ */
+static unsigned int CH341AsyncDepth;
+static unsigned int CH341AsyncInFlight;
+static int CH341AsyncError;
+
+static unsigned char CH341AsyncReadBuffer[CH341_PACKET_LENGTH];
+static bool CH341AsyncReading;
+
+static void LIBUSB_CALL CH341AsyncWriteDone(struct libusb_transfer *transfer)
+{
+	struct ch341_transfer *slot = transfer->user_data;
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED)
+	{
+		fprintf(stderr, "Error: asynchronous write to CH341 failed: %d\n", transfer->status);
+		CH341AsyncError = LIBUSB_ERROR_IO;
+	}
+	else if (transfer->actual_length != transfer->length)
+	{
+		fprintf(stderr, "Error: short asynchronous write to CH341: %d of %d\n", transfer->actual_length, transfer->length);
+		CH341AsyncError = LIBUSB_ERROR_IO;
+	}
+
+	slot->busy = false;
+	CH341AsyncInFlight--;
+}
+
+static void LIBUSB_CALL CH341AsyncReadDone(struct libusb_transfer *transfer)
+{
+	int ret;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED && CH341AsyncDepth)
+	{
+		if (!(ret = libusb_submit_transfer(transfer)))
+			return;
+
+		fprintf(stderr, "Error: libusb_submit_transfer for IN_EP failed: %d (%s)\n", ret, libusb_error_name(ret));
+		CH341AsyncError = ret;
+	}
+	else if (transfer->status != LIBUSB_TRANSFER_COMPLETED && transfer->status != LIBUSB_TRANSFER_CANCELLED)
+	{
+		fprintf(stderr, "Error: asynchronous read from CH341 failed: %d\n", transfer->status);
+		CH341AsyncError = LIBUSB_ERROR_IO;
+	}
+
+	CH341AsyncReading = false;
+}
+
+static bool CH341AsyncHandleEvents(bool wait)
+{
+	struct timeval tv = {0, 0};
+	int ret;
+
+	if (wait)
+		ret = libusb_handle_events(NULL);
+	else
+		ret = libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+
+	if (ret)
+	{
+		fprintf(stderr, "Error: libusb_handle_events failed: %d (%s)\n", ret, libusb_error_name(ret));
+		return false;
+	}
+
+	return true;
+}
+
+bool CH341AsyncInit(unsigned int depth)
+{
+	int ret;
+
+	if (!CH341Device.handle)
+		return false;
+
+	if (!depth || depth > CH341_MAX_ASYNC_DEPTH)
+	{
+		fprintf(stderr, "Error: invalid queue depth %u, 1~%d are available\n", depth, CH341_MAX_ASYNC_DEPTH);
+		return false;
+	}
+
+	/* Anything queued by the synchronous path must not reach the reader */
+	if (!CH341FlushSPI())
+		return false;
+
+	libusb_fill_bulk_transfer(CH341Device.reader, CH341Device.handle, CH341_USB_BULK_ENDPOINT | LIBUSB_ENDPOINT_IN,
+		CH341AsyncReadBuffer, sizeof (CH341AsyncReadBuffer), CH341AsyncReadDone, NULL, 0);
+
+	CH341AsyncDepth = depth;
+	CH341AsyncInFlight = 0;
+	CH341AsyncError = 0;
+
+	if ((ret = libusb_submit_transfer(CH341Device.reader)))
+	{
+		fprintf(stderr, "Error: libusb_submit_transfer for IN_EP failed: %d (%s)\n", ret, libusb_error_name(ret));
+		CH341AsyncDepth = 0;
+		return false;
+	}
+
+	CH341AsyncReading = true;
+
+	return true;
+}
+
+/* Reaps whatever has completed and returns a free slot, only blocking when every slot is busy */
+static struct ch341_transfer *CH341AsyncSlot(void)
+{
+	unsigned int i;
+
+	if (!CH341AsyncHandleEvents(false))
+		return NULL;
+
+	while (CH341AsyncInFlight == CH341AsyncDepth)
+	{
+		if (!CH341AsyncHandleEvents(true))
+			return NULL;
+	}
+
+	if (CH341AsyncError)
+		return NULL;
+
+	for (i = 1; i <= CH341AsyncDepth; i++)
+	{
+		if (!CH341Device.pool[i].busy)
+			return &CH341Device.pool[i];
+	}
+
+	return NULL;
+}
+
+static bool CH341AsyncSubmit(struct ch341_transfer *slot, unsigned int length)
+{
+	int ret;
+
+	libusb_fill_bulk_transfer(slot->transfer, CH341Device.handle, CH341_USB_BULK_ENDPOINT | LIBUSB_ENDPOINT_OUT,
+		slot->buffer, length, CH341AsyncWriteDone, slot, CH341_USB_TIMEOUT);
+
+	if ((ret = libusb_submit_transfer(slot->transfer)))
+	{
+		fprintf(stderr, "Error: libusb_submit_transfer for OUT_EP failed: %d (%s)\n", ret, libusb_error_name(ret));
+		return false;
+	}
+
+	slot->busy = true;
+	CH341AsyncInFlight++;
+
+	return true;
+}
+
+bool CH341AsyncSubmitWords(unsigned int cs, const uint32_t *words, unsigned int count)
+{
+	struct ch341_transfer *slot;
+
+	if (!CH341AsyncDepth)
+		return CH341WriteSPIWords(cs, words, count);
+
+	if (!count)
+		return true;
+
+	if (cs > 3 || count > CH341_MAX_WORDS)
+	{
+		fprintf(stderr, "Error: invalid asynchronous SPI write (CS %u, %u words)\n", cs, count);
+		return false;
+	}
+
+	if (!(slot = CH341AsyncSlot()))
+		return false;
+
+	return CH341AsyncSubmit(slot, CH341BuildSPIWords(slot->buffer, cs, words, count));
+}
+
+bool CH341AsyncFlush(void)
+{
+	while (CH341AsyncInFlight)
+	{
+		if (!CH341AsyncHandleEvents(true))
+			return false;
+	}
+
+	return !CH341AsyncError;
+}
+
+void CH341AsyncRelease(void)
+{
+	if (!CH341AsyncDepth)
+		return;
+
+	CH341AsyncFlush();
+
+	CH341AsyncDepth = 0;
+
+	if (CH341AsyncReading)
+		libusb_cancel_transfer(CH341Device.reader);
+
+	while (CH341AsyncReading)
+	{
+		if (!CH341AsyncHandleEvents(true))
+			break;
+	}
+}
+
+/*
+ * Two phase write. CH341PrepareSPIWords() builds the stream in a dedicated
+ * buffer so that CH341CommitSPIWords() only has to send it, as one more
+ * write on the asynchronous queue when it is running or as a single bulk OUT
+ * transfer otherwise. Neither waits for queued writes or drains readback
+ * early, so the queue depth and drain interval apply as to any other write.
+ * The staged stream is sent once.
+ */
+static unsigned char CH341StagedStream[CH341_WORDS_STREAM_LENGTH(CH341_MAX_WORDS)];
+static unsigned int CH341StagedLength;
+static unsigned int CH341StagedWords;
+
+bool CH341PrepareSPIWords(unsigned int cs, const uint32_t *words, unsigned int count)
+{
+	CH341StagedLength = 0;
+	CH341StagedWords = 0;
+
+	if (cs > 3 || count > CH341_MAX_WORDS)
+	{
+		fprintf(stderr, "Error: invalid SPI words to prepare (CS %u, %u words)\n", cs, count);
+		return false;
+	}
+
+	if (count)
+	{
+		CH341StagedLength = CH341BuildSPIWords(CH341StagedStream, cs, words, count);
+		CH341StagedWords = count;
+	}
+
+	return true;
+}
+
+bool CH341CommitSPIWords(void)
+{
+	unsigned int count = CH341StagedWords;
+	unsigned int length = CH341StagedLength;
+	struct ch341_transfer *slot;
+
+	if (!CH341StagedLength)
+		return true;
+
+	CH341StagedWords = 0;
+
+	/* With the queue running the posted reader takes the readback */
+	if (CH341AsyncDepth)
+	{
+		if (!(slot = CH341AsyncSlot()))
+		{
+			CH341StagedLength = 0;
+			return false;
+		}
+
+		memcpy(slot->buffer, CH341StagedStream, length);
+		CH341StagedLength = 0;
+
+		return CH341AsyncSubmit(slot, length);
+	}
+
+	if (!CH341USBWrite(CH341StagedStream, CH341StagedLength))
+	{
+		CH341StagedLength = 0;
+		fprintf(stderr, "Error: failed to transfer prepared words to CH341\n");
+		return false;
+	}
+
+	CH341StagedLength = 0;
+
+	return CH341CompleteSPI(count);
+}
+
+/*
+ * Samples the D0~D7 inputs. The state byte comes back on the IN endpoint, so
+ * any SPI readback still queued there is drained first. Not available while
+ * the asynchronous queue is running, as its posted reader would take the
+ * byte.
+ */
+bool CH341ReadInputs(unsigned char *inputs)
+{
+	unsigned char pkt[3];
+
+	if (CH341AsyncDepth)
+	{
+		fprintf(stderr, "Error: CH341 inputs can not be read with the asynchronous queue running\n");
+		return false;
+	}
+
+	if (!CH341FlushSPI())
+		return false;
+
+	pkt[0] = CH341_CMD_UIO_STREAM;
+	pkt[1] = CH341_CMD_UIO_STM_IN;
+	pkt[2] = CH341_CMD_UIO_STM_END;
+
+	if (!CH341USBWrite(pkt, sizeof (pkt)) || !CH341USBRead(inputs, 1))
+	{
+		fprintf(stderr, "Error: failed to read CH341 inputs\n");
+		return false;
+	}
+
+	return true;
+}
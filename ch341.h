@@ -12,12 +12,18 @@
 #define _CH341_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define CH341_USB_VID				0x1A86
 #define CH341_USB_PID				0x5512
 
 #define CH341_USB_BULK_ENDPOINT		0x02
 #define CH341_PACKET_LENGTH			0x20
+#define CH341_MAX_WORDS				8
+#define CH341_WORDS_STREAM_LENGTH(n)	((1 + 2 * (n)) * CH341_PACKET_LENGTH)
+
+#define CH341_MAX_PENDING_PACKETS	64
+#define CH341_MAX_ASYNC_DEPTH		16
 
 #define CH341_USB_TIMEOUT			15000
 
@@ -31,12 +37,27 @@
 
 bool CH341DeviceInit(void);
 void CH341DeviceRelease(void);
+unsigned long CH341TransferAllocations(void);
 
 bool CH341ChipSelect(unsigned int cs, bool enable);
+bool CH341ReadInputs(unsigned char *inputs);
 bool CH341StreamSPI(const unsigned char *in, unsigned char *out, unsigned int size);
 bool CH341ReadSPI(unsigned char *out, unsigned int size);
 bool CH341WriteSPI(const unsigned char *in, unsigned int size);
 
+unsigned int CH341BuildSPIWords(unsigned char *stream, unsigned int cs, const uint32_t *words, unsigned int count);
+bool CH341WriteSPIWords(unsigned int cs, const uint32_t *words, unsigned int count);
+bool CH341PrepareSPIWords(unsigned int cs, const uint32_t *words, unsigned int count);
+bool CH341CommitSPIWords(void);
+
+void CH341SetWriteOnly(unsigned int drain_hops);
+bool CH341FlushSPI(void);
+
+bool CH341AsyncInit(unsigned int depth);
+bool CH341AsyncSubmitWords(unsigned int cs, const uint32_t *words, unsigned int count);
+bool CH341AsyncFlush(void);
+void CH341AsyncRelease(void);
+
 static inline bool SPIWrite(const unsigned char *data, unsigned int size)
 {
 	if (!CH341ChipSelect(0, true))
@@ -0,0 +1,530 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include "transport.h"
+#include "sweep.h"
+#include "daemon.h"
+
+#ifndef _WIN32
+
+typedef struct {
+    int iFd;
+    char acLine[DAEMON_LINE_LENGTH];
+    size_t uLength;
+} DAEMON_tsClient;
+
+typedef struct {
+    ADF435x_tsContext *psContext;
+    ADF435X_DEV_tsDevice *psDevice;
+
+    DAEMON_tsClient asClients[DAEMON_MAX_CLIENTS];
+
+    // Frequency currently set, 0 if none yet
+    uint64_t u64Frequency;
+
+    SWEEP_tsStepper sStepper;
+    bool bStepper;
+    bool bSweeping;
+    uint64_t u64DwellNs;
+    uint64_t u64DeadlineNs;
+
+    bool bShutdown;
+} DAEMON_tsServer;
+
+static bool DAEMON_bSetFrequency(DAEMON_tsServer *psServer, uint64_t u64FrequencyHz);
+static bool DAEMON_bChangeOptions(DAEMON_tsServer *psServer, ADF435x_tsOptions *psOptions);
+static void DAEMON_vStep(DAEMON_tsServer *psServer);
+static void DAEMON_vStopSweep(DAEMON_tsServer *psServer);
+static void DAEMON_vRead(DAEMON_tsServer *psServer, DAEMON_tsClient *psClient);
+static void DAEMON_vCommand(DAEMON_tsServer *psServer, DAEMON_tsClient *psClient, char *pcLine);
+static void DAEMON_vReply(DAEMON_tsClient *psClient, const char *pcFormat, ...);
+static void DAEMON_vClose(DAEMON_tsClient *psClient);
+
+// Serves commands on pcPath until SHUTDOWN or until iSignalFd (-1 for
+// none) becomes readable. The device is left as the last command set it.
+bool DAEMON_bRun(const char *pcPath, ADF435x_tsContext *psContext, ADF435X_DEV_tsDevice *psDevice, int iSignalFd)
+{
+    static DAEMON_tsServer sServer;
+    struct sockaddr_un sAddress;
+    struct stat sStat;
+    struct pollfd asFds[2 + DAEMON_MAX_CLIENTS];
+    struct timespec sTimeout;
+    uint64_t u64NowNs;
+    nfds_t uFds;
+    int iListen;
+    int iFd;
+
+    memset(&sServer, 0, sizeof(sServer));
+    sServer.psContext = psContext;
+    sServer.psDevice = psDevice;
+    for(int n = 0; n < DAEMON_MAX_CLIENTS; n++)
+    {
+        sServer.asClients[n].iFd = -1;
+    }
+
+    if(strlen(pcPath) >= sizeof(sAddress.sun_path))
+    {
+        printf("Daemon socket path is too long\n");
+        return false;
+    }
+
+    memset(&sAddress, 0, sizeof(sAddress));
+    sAddress.sun_family = AF_UNIX;
+    strcpy(sAddress.sun_path, pcPath);
+
+    iListen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(iListen < 0)
+    {
+        printf("Error creating daemon socket: %s\n", strerror(errno));
+        return false;
+    }
+
+    // Replace a socket left behind by an earlier run, but nothing else
+    if(lstat(pcPath, &sStat) == 0)
+    {
+        if(!S_ISSOCK(sStat.st_mode))
+        {
+            printf("Error: %s exists and is not a socket\n", pcPath);
+            close(iListen);
+            return false;
+        }
+        unlink(pcPath);
+    }
+    else if(errno != ENOENT)
+    {
+        printf("Error checking %s: %s\n", pcPath, strerror(errno));
+        close(iListen);
+        return false;
+    }
+
+    if(bind(iListen, (struct sockaddr *)&sAddress, sizeof(sAddress)) < 0 || listen(iListen, DAEMON_MAX_CLIENTS) < 0)
+    {
+        printf("Error listening on %s: %s\n", pcPath, strerror(errno));
+        close(iListen);
+        return false;
+    }
+
+    printf("Daemon listening on %s\n", pcPath);
+
+    while(!sServer.bShutdown)
+    {
+        uFds = 0;
+
+        asFds[uFds].fd = iListen;
+        asFds[uFds].events = POLLIN;
+        uFds++;
+
+        asFds[uFds].fd = iSignalFd;
+        asFds[uFds].events = POLLIN;
+        uFds++;
+
+        for(int n = 0; n < DAEMON_MAX_CLIENTS; n++)
+        {
+            asFds[uFds].fd = sServer.asClients[n].iFd;
+            asFds[uFds].events = POLLIN;
+            uFds++;
+        }
+
+        for(nfds_t n = 0; n < uFds; n++)
+        {
+            asFds[n].revents = 0;
+        }
+
+        // Sleep until the next command, or the next sweep step is due.
+        // Negative descriptors are ignored by poll.
+        if(sServer.bSweeping)
+        {
+            u64NowNs = TRANSPORT_u64TimeNs();
+            u64NowNs = sServer.u64DeadlineNs > u64NowNs ? sServer.u64DeadlineNs - u64NowNs : 0;
+            sTimeout.tv_sec = u64NowNs / 1000000000ULL;
+            sTimeout.tv_nsec = u64NowNs % 1000000000ULL;
+        }
+
+        if(ppoll(asFds, uFds, sServer.bSweeping ? &sTimeout : NULL, NULL) < 0 && errno != EINTR)
+        {
+            printf("Error: ppoll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if(asFds[1].revents)
+        {
+            printf("\nExit requested\n");
+            break;
+        }
+
+        if(sServer.bSweeping && TRANSPORT_u64TimeNs() >= sServer.u64DeadlineNs)
+        {
+            DAEMON_vStep(&sServer);
+        }
+
+        if(asFds[0].revents)
+        {
+            while((iFd = accept4(iListen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+            {
+                int n;
+
+                for(n = 0; n < DAEMON_MAX_CLIENTS && sServer.asClients[n].iFd >= 0; n++);
+
+                if(n == DAEMON_MAX_CLIENTS)
+                {
+                    close(iFd);
+                    continue;
+                }
+
+                sServer.asClients[n].iFd = iFd;
+                sServer.asClients[n].uLength = 0;
+            }
+        }
+
+        for(int n = 0; n < DAEMON_MAX_CLIENTS && !sServer.bShutdown; n++)
+        {
+            if(asFds[2 + n].revents && sServer.asClients[n].iFd >= 0)
+            {
+                DAEMON_vRead(&sServer, &sServer.asClients[n]);
+            }
+        }
+    }
+
+    DAEMON_vStopSweep(&sServer);
+
+    for(int n = 0; n < DAEMON_MAX_CLIENTS; n++)
+    {
+        DAEMON_vClose(&sServer.asClients[n]);
+    }
+
+    close(iListen);
+    unlink(pcPath);
+
+    return true;
+}
+
+static bool DAEMON_bSetFrequency(DAEMON_tsServer *psServer, uint64_t u64FrequencyHz)
+{
+    ADF435X_tsSettings sSettings;
+    ADF435X_tuRegisters uRegisters;
+
+    if(!ADF435x_bCalculateSettings(psServer->psContext, u64FrequencyHz, &sSettings) ||
+       !ADF435x_bGenerateRegisters(psServer->psContext, &sSettings, &uRegisters))
+    {
+        return false;
+    }
+
+    if(!ADF435x_DEV_bWriteRegisters(psServer->psDevice, &uRegisters))
+    {
+        ADF435x_vSetError(psServer->psContext, "Failed to write registers.");
+        return false;
+    }
+
+    psServer->u64Frequency = u64FrequencyHz;
+
+    return true;
+}
+
+// Applies new options and rewrites the current frequency with them, the old
+// options are kept if either fails
+static bool DAEMON_bChangeOptions(DAEMON_tsServer *psServer, ADF435x_tsOptions *psOptions)
+{
+    ADF435x_tsOptions sPrevious = psServer->psContext->sOptions;
+    char acError[ADF435X_ERROR_LENGTH];
+
+    if(ADF435x_bSetOptions(psServer->psContext, psOptions) &&
+       (psServer->u64Frequency == 0 || DAEMON_bSetFrequency(psServer, psServer->u64Frequency)))
+    {
+        return true;
+    }
+
+    strcpy(acError, ADF435x_pcGetError(psServer->psContext));
+    ADF435x_bSetOptions(psServer->psContext, &sPrevious);
+    ADF435x_vSetError(psServer->psContext, "%s", acError);
+
+    return false;
+}
+
+static void DAEMON_vStep(DAEMON_tsServer *psServer)
+{
+    ADF435X_tuRegisters uRegisters;
+    uint64_t u64FrequencyHz;
+    uint64_t u64NowNs;
+
+    if(!SWEEP_bStep(&psServer->sStepper, &uRegisters, &u64FrequencyHz))
+    {
+        if(psServer->sStepper.bInvalid)
+        {
+            printf("%s\n", ADF435x_pcGetError(psServer->psContext));
+            DAEMON_vStopSweep(psServer);
+            return;
+        }
+
+        SWEEP_vRewindStepper(&psServer->sStepper);
+        if(!SWEEP_bStep(&psServer->sStepper, &uRegisters, &u64FrequencyHz))
+        {
+            DAEMON_vStopSweep(psServer);
+            return;
+        }
+    }
+
+    if(!ADF435x_DEV_bWriteRegisters(psServer->psDevice, &uRegisters))
+    {
+        // The device is wherever the failed write left it, so stop here
+        // rather than step blindly on
+        ADF435x_vSetError(psServer->psContext, "Failed to write registers.");
+        printf("%s\n", ADF435x_pcGetError(psServer->psContext));
+        DAEMON_vStopSweep(psServer);
+        return;
+    }
+    psServer->u64Frequency = u64FrequencyHz;
+
+    // Keep to the schedule, skipping any slots that have already passed
+    psServer->u64DeadlineNs += psServer->u64DwellNs;
+    u64NowNs = TRANSPORT_u64TimeNs();
+    if(u64NowNs >= psServer->u64DeadlineNs + psServer->u64DwellNs)
+    {
+        psServer->u64DeadlineNs += ((u64NowNs - psServer->u64DeadlineNs) / psServer->u64DwellNs) * psServer->u64DwellNs;
+    }
+}
+
+static void DAEMON_vStopSweep(DAEMON_tsServer *psServer)
+{
+    psServer->bSweeping = false;
+
+    if(psServer->bStepper)
+    {
+        SWEEP_vFreeStepper(&psServer->sStepper);
+        psServer->bStepper = false;
+    }
+}
+
+static void DAEMON_vRead(DAEMON_tsServer *psServer, DAEMON_tsClient *psClient)
+{
+    char acBuffer[256];
+    ssize_t iRead;
+    char *pcEnd;
+
+    iRead = read(psClient->iFd, acBuffer, sizeof(acBuffer));
+    if(iRead == 0 || (iRead < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        DAEMON_vClose(psClient);
+        return;
+    }
+
+    // Nothing after a SHUTDOWN is run, from this client or any other
+    for(ssize_t n = 0; n < iRead && psClient->iFd >= 0 && !psServer->bShutdown; n++)
+    {
+        if(acBuffer[n] == '\n')
+        {
+            psClient->acLine[psClient->uLength] = '\0';
+            if((pcEnd = strchr(psClient->acLine, '\r')) != NULL)
+            {
+                *pcEnd = '\0';
+            }
+            psClient->uLength = 0;
+            DAEMON_vCommand(psServer, psClient, psClient->acLine);
+        }
+        else if(psClient->uLength < DAEMON_LINE_LENGTH - 1)
+        {
+            psClient->acLine[psClient->uLength++] = acBuffer[n];
+        }
+        else
+        {
+            DAEMON_vReply(psClient, "ERR Line too long");
+            DAEMON_vClose(psClient);
+        }
+    }
+}
+
+static void DAEMON_vCommand(DAEMON_tsServer *psServer, DAEMON_tsClient *psClient, char *pcLine)
+{
+    ADF435x_tsOptions sOptions = psServer->psContext->sOptions;
+    unsigned long long au64Args[4];
+    char acCommand[16];
+    int iArgs;
+
+    iArgs = sscanf(pcLine, "%15s %llu %llu %llu %llu", acCommand, &au64Args[0], &au64Args[1], &au64Args[2], &au64Args[3]) - 1;
+    if(iArgs < 0)
+    {
+        DAEMON_vReply(psClient, "ERR Empty command");
+        return;
+    }
+
+    if(strcmp(acCommand, "FREQ") == 0 && iArgs == 1)
+    {
+        DAEMON_vStopSweep(psServer);
+        if(DAEMON_bSetFrequency(psServer, au64Args[0]))
+        {
+            DAEMON_vReply(psClient, "OK %llu", au64Args[0]);
+        }
+        else
+        {
+            DAEMON_vReply(psClient, "ERR %s", ADF435x_pcGetError(psServer->psContext));
+        }
+    }
+    else if((strcmp(acCommand, "POWER") == 0 || strcmp(acCommand, "OUTPUT") == 0) && iArgs == 1)
+    {
+        if(psServer->bSweeping)
+        {
+            DAEMON_vReply(psClient, "ERR Stop the sweep first");
+        }
+        else if(acCommand[0] == 'P' && au64Args[0] > E_ADF435X_OUTPUT_POWER_PLUS_5dBm)
+        {
+            DAEMON_vReply(psClient, "ERR Output power must be 0 to 3");
+        }
+        else
+        {
+            if(acCommand[0] == 'P')
+            {
+                sOptions.eOutputPower = au64Args[0];
+            }
+            else
+            {
+                sOptions.bOutputEnable = au64Args[0] != 0;
+            }
+
+            if(DAEMON_bChangeOptions(psServer, &sOptions))
+            {
+                DAEMON_vReply(psClient, "OK %llu", au64Args[0]);
+            }
+            else
+            {
+                DAEMON_vReply(psClient, "ERR %s", ADF435x_pcGetError(psServer->psContext));
+            }
+        }
+    }
+    else if(strcmp(acCommand, "SWEEP") == 0 && iArgs == 4)
+    {
+        DAEMON_vStopSweep(psServer);
+
+        if(au64Args[3] == 0 || au64Args[3] > DAEMON_MAX_DWELL_US)
+        {
+            DAEMON_vReply(psClient, "ERR Dwell must be 1 to %lluus", DAEMON_MAX_DWELL_US);
+        }
+        else if(!SWEEP_bInitStepper(&psServer->sStepper, psServer->psContext, au64Args[0], au64Args[1], au64Args[2]))
+        {
+            DAEMON_vReply(psClient, "ERR %s", ADF435x_pcGetError(psServer->psContext));
+        }
+        else
+        {
+            psServer->bStepper = true;
+            psServer->bSweeping = true;
+            psServer->u64DwellNs = au64Args[3] * 1000ULL;
+            SWEEP_vRewindStepper(&psServer->sStepper);
+
+            // The first step is due now
+            psServer->u64DeadlineNs = TRANSPORT_u64TimeNs();
+            DAEMON_vStep(psServer);
+
+            if(psServer->bSweeping)
+            {
+                DAEMON_vReply(psClient, "OK");
+            }
+            else
+            {
+                DAEMON_vReply(psClient, "ERR %s", ADF435x_pcGetError(psServer->psContext));
+            }
+        }
+    }
+    else if(strcmp(acCommand, "STOP") == 0 && iArgs == 0)
+    {
+        DAEMON_vStopSweep(psServer);
+        DAEMON_vReply(psClient, "OK %llu", (unsigned long long)psServer->u64Frequency);
+    }
+    else if(strcmp(acCommand, "STATUS") == 0 && iArgs == 0)
+    {
+        DAEMON_vReply(psClient, "OK freq=%llu sweep=%d output=%d power=%d written=%llu skipped=%llu",
+                      (unsigned long long)psServer->u64Frequency, psServer->bSweeping ? 1 : 0,
+                      sOptions.bOutputEnable ? 1 : 0, (int)sOptions.eOutputPower,
+                      (unsigned long long)psServer->psDevice->u64WordsWritten,
+                      (unsigned long long)psServer->psDevice->u64WordsSkipped);
+    }
+    else if(strcmp(acCommand, "SHUTDOWN") == 0 && iArgs == 0)
+    {
+        DAEMON_vReply(psClient, "OK");
+        psServer->bShutdown = true;
+    }
+    else
+    {
+        DAEMON_vReply(psClient, "ERR Unknown command");
+    }
+}
+
+static void DAEMON_vReply(DAEMON_tsClient *psClient, const char *pcFormat, ...)
+{
+    char acReply[DAEMON_LINE_LENGTH + ADF435X_ERROR_LENGTH];
+    va_list args;
+    int iLength;
+
+    va_start(args, pcFormat);
+    iLength = vsnprintf(acReply, sizeof(acReply) - 1, pcFormat, args);
+    va_end(args);
+
+    if(iLength < 0)
+    {
+        return;
+    }
+    if(iLength > (int)sizeof(acReply) - 2)
+    {
+        iLength = sizeof(acReply) - 2;
+    }
+    acReply[iLength++] = '\n';
+
+    // Replies are short, a client that can not take one is dropped
+    if(send(psClient->iFd, acReply, iLength, MSG_NOSIGNAL) != iLength)
+    {
+        DAEMON_vClose(psClient);
+    }
+}
+
+static void DAEMON_vClose(DAEMON_tsClient *psClient)
+{
+    if(psClient->iFd >= 0)
+    {
+        close(psClient->iFd);
+        psClient->iFd = -1;
+    }
+}
+
+#else
+
+bool DAEMON_bRun(const char *pcPath, ADF435x_tsContext *psContext, ADF435X_DEV_tsDevice *psDevice, int iSignalFd)
+{
+    printf("Daemon mode is not supported on Windows\n");
+
+    return false;
+}
+
+#endif
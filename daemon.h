@@ -0,0 +1,48 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _DAEMON_H_
+#define _DAEMON_H_
+
+#include <stdbool.h>
+#include "adf435x.h"
+#include "adf435x_dev.h"
+
+#define DAEMON_MAX_CLIENTS          (8)
+#define DAEMON_LINE_LENGTH          (128)
+#define DAEMON_MAX_DWELL_US         (3600000000ULL)
+
+// Long running server that keeps the device open and takes line based
+// commands on a Unix domain socket, so a frequency change costs a socket
+// round trip rather than a process start and USB enumeration. Each command
+// is one line and gets one line back, "OK ..." or "ERR <reason>":
+//
+//   FREQ <hz>                          Set the output frequency
+//   POWER <0~3>                        Set the output power, -4dBm to +5dBm
+//   OUTPUT <0|1>                       Switch the output off or on
+//   SWEEP <low> <high> <step> <dwell>  Sweep, dwelling <dwell> microseconds,
+//                                      up to DAEMON_MAX_DWELL_US
+//   STOP                               Stop a sweep where it is
+//   STATUS                             Frequency, sweep state and word counts
+//   SHUTDOWN                           Stop the daemon
+bool DAEMON_bRun(const char *pcPath, ADF435x_tsContext *psContext, ADF435X_DEV_tsDevice *psDevice, int iSignalFd);
+
+#endif // _DAEMON_H_
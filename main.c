@@ -32,15 +32,29 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
 #endif
 
 #include "ch341.h"
 #include "adf435x.h"
+#include "transport.h"
+#include "adf435x_sim.h"
+#include "adf435x_dev.h"
+#include "sweep.h"
+#include "pacer.h"
+#include "realtime.h"
+#include "pipeline.h"
+#include "daemon.h"
 
 /****************************************************************************/
 /***        Macro Definitions                                             ***/
 /****************************************************************************/
 
+#define MOCK_EVENT_CAPACITY		4096
+
 /****************************************************************************/
 /***        Type Definitions                                              ***/
 /****************************************************************************/
@@ -71,7 +85,20 @@ typedef struct
 	uint64_t			u64FreqHigh;
 	uint64_t			u64FreqStep;
 	teVerbosity			eVerbosity;
-	int					iDelay;
+	uint64_t			u64DwellUs;
+	uint64_t			u64SpinUs;
+	bool				bRealtime;
+	int					iRealtimeCpu;
+	bool				bPipeline;
+	const char			*pcDaemonPath;
+	int					iDrainHops;
+	int					iQueueDepth;
+	bool				bMock;
+	bool				bBestFracMod;
+	bool				bIncremental;
+	bool				bConstantMod;
+	int					iLockTimeout;
+	int					iLockPin;
 } tsInstance;
 
 /****************************************************************************/
@@ -82,9 +109,14 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 
 #ifdef _WIN32
 static BOOL WINAPI bCtrlHandler(DWORD dwCtrlType);
+#else
+static int iInitSignals(void);
 #endif
+static void vPollSignals(void);
 
-bool bConfigureADF435x(ADF435x_tsOptions *psOptions, uint64_t u64FrequencyHz);
+bool bConfigureADF435x(ADF435x_tsContext *psContext, uint64_t u64FrequencyHz);
+static bool bStepperSource(void *pvUser, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency);
+static bool bCalculateSource(void *pvUser, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency);
 
 /****************************************************************************/
 /***        Exported Variables                                            ***/
@@ -96,6 +128,21 @@ bool bConfigureADF435x(ADF435x_tsOptions *psOptions, uint64_t u64FrequencyHz);
 
 static tsInstance sInstance;
 
+static TRANSPORT_tsBackend sTransport;
+static TRANSPORT_tsCH341Config sCH341Config;
+static TRANSPORT_tsMock sMock;
+static TRANSPORT_tsMockEvent asMockEvents[MOCK_EVENT_CAPACITY];
+static ADF435X_SIM_tsDevice sSim;
+static ADF435X_DEV_tsDevice sDevice;
+static PACER_tsPacer sPacer;
+static PIPELINE_tsPipeline sPipeline;
+
+// Next frequency for the calculating pipeline source
+static uint64_t u64SourceFrequency;
+
+// Delivers exit signals during a sweep, not used on Windows
+static int iSignalFd = -1;
+
 /****************************************************************************/
 /***        Exported Functions                                            ***/
 /****************************************************************************/
@@ -113,15 +160,6 @@ static tsInstance sInstance;
  ****************************************************************************/
 int main(int argc, char *argv[])
 {
-
-
-	int n;
-
-	bool_t bOk = TRUE;
-
-	char acOut[] = {0xaa, 0x55, 0x01, 0x02, 0x03, 0x04};
-	char acWord[4] = {0};
-
 	/* Initialise application state and set some defaults */
 	sInstance.bExitRequest = FALSE;
 	sInstance.eVerbosity = E_VERBOSITY_MEDIUM;
@@ -131,9 +169,23 @@ int main(int argc, char *argv[])
 	sInstance.u64FreqLow = 50000000;
 	sInstance.u64FreqHigh = 100000000;
 	sInstance.u64FreqStep = 100000;
-	sInstance.iDelay = 1;
+	sInstance.u64DwellUs = 1000;
+	sInstance.u64SpinUs = 0;
+	sInstance.bRealtime = false;
+	sInstance.iRealtimeCpu = -1;
+	sInstance.bPipeline = false;
+	sInstance.pcDaemonPath = NULL;
+	sInstance.iDrainHops = 1;
+	sInstance.iQueueDepth = 0;
+	sInstance.bMock = false;
+	sInstance.bBestFracMod = false;
+	sInstance.bIncremental = false;
+	sInstance.bConstantMod = false;
+	sInstance.iLockTimeout = 0;
+	sInstance.iLockPin = 7;
 
 	ADF435x_tsOptions sOptions;
+	ADF435x_tsContext sContext;
 
 	printf("+----------------------------------------------------------------------+\n" \
 	"|              ADF435xCFG (ADF435x Configurator)                       |\n" \
@@ -147,54 +199,379 @@ int main(int argc, char *argv[])
 	"| If not, see <http://www.gnu.org/licenses/>.                          |\n" \
 	"+----------------------------------------------------------------------+\n\n");
 
+#ifdef _WIN32
     SetConsoleCtrlHandler(bCtrlHandler, TRUE);
+#endif
 
 	// Initialise options struct for ADF435x device
 	ADF435x_vGetOptions(&sOptions);
 
 	// Parse the command line options
 	vParseCommandLineOptions(&sInstance, argc, argv);
+	sOptions.bBestFracMod = sInstance.bBestFracMod;
 
-	// Initialise the CH4351A UAB to SPI adapter
-	if(!CH341DeviceInit())
+	// When sweeping, let output divider changes commit together with R0
+	if(sInstance.bSweepMode)
 	{
-		printf("Error at line %d\n", __LINE__);
+		sOptions.bDoubleBufR4 = true;
 	}
 
-	// Disable chip select
-	if(!CH341ChipSelect(0, FALSE))
+	// Step as soon as the PLL reports lock rather than after a fixed delay
+	if(sInstance.bSweepMode && sInstance.iLockTimeout)
+	{
+		sOptions.eMuxOut = E_ADF435X_MUX_OUT_DIGITAL_LOCK_DETECT;
+
+		if(sInstance.iQueueDepth)
+		{
+			printf("Lock detect needs a blocking USB transport, queue disabled\n");
+			sInstance.iQueueDepth = 0;
+		}
+	}
+
+	// Select the SPI transport, either the CH341A USB to SPI adapter or an
+	// in-memory mock for benchmarking without hardware
+	if(sInstance.bMock)
+	{
+		TRANSPORT_vInitMock(&sTransport, &sMock, asMockEvents, MOCK_EVENT_CAPACITY);
+
+		// Decode the SPI stream with a simulated ADF435x
+		ADF435x_SIM_vInit(&sSim, sOptions.u64ReferenceFrequencyHz);
+		ADF435x_SIM_vAttach(&sSim, &sMock);
+	}
+	else
+	{
+		sCH341Config.uDrainHops = sInstance.iDrainHops;
+		sCH341Config.uQueueDepth = sInstance.iQueueDepth;
+		sCH341Config.uLockDetectPin = sInstance.iLockPin;
+		TRANSPORT_vInitCH341(&sTransport, &sCH341Config);
+	}
+
+	// Initialise the transport, this leaves chip select disabled
+	if(!sTransport.pfInit(&sTransport))
 	{
 		printf("Error at line %d\n", __LINE__);
 	}
 
-	// Initialise ADF435x functions
-	ADF435x_vInit(E_ADF435X_VERBOSITY_LOW);
+	// Track the registers on the device so only changes are written
+	ADF435x_DEV_vInit(&sDevice, &sTransport);
 
-	if(sInstance.bSweepMode)
+	// Initialise the ADF435x calculation context, this validates the options
+	if(!ADF435x_bInitContext(&sContext, &sOptions, E_ADF435X_VERBOSITY_LOW))
 	{
+		printf("%s\n", ADF435x_pcGetError(&sContext));
+	}
+	else if(sInstance.pcDaemonPath)
+	{
+#ifndef _WIN32
+		iSignalFd = iInitSignals();
+#endif
+
+		// Keep the device open and take commands until told to stop
+		DAEMON_bRun(sInstance.pcDaemonPath, &sContext, &sDevice, iSignalFd);
+
+		// Switch the output off before we exit
+		sOptions = sContext.sOptions;
+		sOptions.bOutputEnable = false;
+		ADF435x_bSetOptions(&sContext, &sOptions);
+		bConfigureADF435x(&sContext, 35000000);
+
+#ifndef _WIN32
+		if(iSignalFd >= 0)
+		{
+			close(iSignalFd);
+		}
+#endif
+	}
+	else if(sInstance.bSweepMode)
+	{
+		SWEEP_tsPlan sPlan;
+		SWEEP_tsStepper sStepper;
+		ADF435X_tuRegisters uRegisters;
+		PIPELINE_tsFrame sFrame;
+		uint64_t f, fNext;
+		bool bSweepOk = true;
+		bool bPrepared = false;
+
+		// Use one MOD for the whole sweep so that within an output divider
+		// band only R0 changes from step to step
+		if(sInstance.bConstantMod)
+		{
+			bSweepOk = SWEEP_bConstantMod(&sContext, sInstance.u64FreqLow, sInstance.u64FreqHigh, sInstance.u64FreqStep, &sOptions.u32FixedMod) &&
+				  ADF435x_bSetOptions(&sContext, &sOptions);
+			if(bSweepOk)
+			{
+				printf("MOD fixed at %u\n", sOptions.u32FixedMod);
+			}
+		}
+
+		if(bSweepOk && sInstance.bIncremental)
+		{
+			// Step INT/FRAC by carry-add, nothing is stored
+			bSweepOk = SWEEP_bInitStepper(&sStepper, &sContext, sInstance.u64FreqLow, sInstance.u64FreqHigh, sInstance.u64FreqStep);
+		}
+		else if(bSweepOk && sInstance.bPipeline)
+		{
+			// Each step is calculated in full by the pipeline producer
+			u64SourceFrequency = sInstance.u64FreqLow;
+			if(sInstance.u64FreqStep == 0 || sInstance.u64FreqHigh < sInstance.u64FreqLow)
+			{
+				ADF435x_vSetError(&sContext, "Sweep range is invalid.");
+				bSweepOk = false;
+			}
+		}
+		else if(bSweepOk)
+		{
+			// Calculate and validate every step once, the loop below only replays it
+			bSweepOk = SWEEP_bCreatePlan(&sPlan, &sContext, sInstance.u64FreqLow, sInstance.u64FreqHigh, sInstance.u64FreqStep, 0);
+		}
+
+		if(!bSweepOk)
+		{
+			printf("%s\n", ADF435x_pcGetError(&sContext));
+			sInstance.bExitRequest = TRUE;
+		}
+
+#ifndef _WIN32
+		// Take exit signals through a descriptor so they can end a step's
+		// wait without interrupting a USB transfer. This comes before any
+		// thread is started, so they all inherit the blocked signals.
+		iSignalFd = iInitSignals();
+#endif
+
+		// Calculate on another thread while this one writes. It is started
+		// before realtime mode so that it does not compete at real time
+		// priority with the writes it feeds.
+		if(bSweepOk && sInstance.bPipeline)
+		{
+			if(sInstance.bIncremental)
+			{
+				SWEEP_vRewindStepper(&sStepper);
+			}
+
+			if(!PIPELINE_bStart(&sPipeline, sInstance.bIncremental ? bStepperSource : bCalculateSource,
+								sInstance.bIncremental ? (void *)&sStepper : (void *)&sContext))
+			{
+				sInstance.bExitRequest = TRUE;
+			}
+		}
+
+		// Everything the loop touches is allocated by now, so this is the
+		// point to lock it in memory and leave the ordinary scheduler. The
+		// USB events are handled on this thread too.
+		if(bSweepOk && sInstance.bRealtime)
+		{
+			if(sInstance.bIncremental)
+			{
+				REALTIME_vPrefault(sStepper.pu16ReducedFrac, sStepper.pu16ReducedFrac ? sStepper.u64Mod * sizeof(uint16_t) : 0);
+				REALTIME_vPrefault(sStepper.pu16ReducedMod, sStepper.pu16ReducedMod ? sStepper.u64Mod * sizeof(uint16_t) : 0);
+			}
+			else if(!sInstance.bPipeline)
+			{
+				REALTIME_vPrefault(sPlan.pu8Counts, sPlan.uPoints);
+				REALTIME_vPrefault(sPlan.pu32Words, sPlan.uWords * sizeof(uint32_t));
+			}
+
+			if(REALTIME_bEnter(sInstance.iRealtimeCpu))
+			{
+				printf("Realtime mode enabled\n");
+			}
+			else
+			{
+				printf("Realtime mode only partly enabled, see above\n");
+			}
+		}
+
+		// Steps are due at fixed intervals from the start of the sweep. With
+		// lock detect there is no schedule, each step follows lock.
+		if(!PACER_bInit(&sPacer, sInstance.iLockTimeout ? 0 : sInstance.u64DwellUs * 1000ULL, sInstance.u64SpinUs * 1000ULL, iSignalFd))
+		{
+			sInstance.bExitRequest = TRUE;
+		}
+
 		/* Main program loop, execute until we get a signal requesting to exit */
 		while(!sInstance.bExitRequest)
 		{
+			vPollSignals();
+			if(sInstance.bExitRequest)
+			{
+				break;
+			}
 
-			for(uint64_t f = sInstance.u64FreqLow; (f <= sInstance.u64FreqHigh) && !sInstance.bExitRequest; f += sInstance.u64FreqStep)
+			// The pipeline producer wraps around by itself
+			if(!sInstance.bPipeline && sInstance.bIncremental)
 			{
-				printf("\r %d.%06dMHz    ", f / 1000000, f % 1000000);
-				bConfigureADF435x(&sOptions, f);
-				Sleep(sInstance.iDelay);
+				SWEEP_vRewindStepper(&sStepper);
+			}
+			else if(!sInstance.bPipeline)
+			{
+				SWEEP_vRewind(&sPlan);
+				bPrepared = false;
 			}
 
+			while(!sInstance.bExitRequest)
+			{
+				if(sInstance.bMock)
+				{
+					ADF435x_SIM_vCommand(&sSim);
+				}
+
+				if(sInstance.bPipeline)
+				{
+					if(!PIPELINE_bPop(&sPipeline, &sFrame))
+					{
+						// The producer only stops on an error
+						printf("\n%s\n", ADF435x_pcGetError(&sContext));
+						sInstance.bExitRequest = TRUE;
+						break;
+					}
+					if(!ADF435x_DEV_bWriteWords(&sDevice, sFrame.au32Words, sFrame.uCount))
+					{
+						printf("\nError writing sweep step\n");
+						sInstance.bExitRequest = TRUE;
+						break;
+					}
+					f = sFrame.u64Frequency;
+				}
+				else if(sInstance.bIncremental)
+				{
+					if(!SWEEP_bStep(&sStepper, &uRegisters, &f))
+					{
+						break;
+					}
+					if(!ADF435x_DEV_bWriteRegisters(&sDevice, &uRegisters))
+					{
+						printf("\nError writing sweep step\n");
+						sInstance.bExitRequest = TRUE;
+						break;
+					}
+				}
+				else
+				{
+					// Prepare now unless it was done while the last step dwelt
+					if(!bPrepared && !sPlan.bError)
+					{
+						bPrepared = SWEEP_bPrepareNext(&sPlan, &sDevice, &fNext);
+					}
+					if(sPlan.bError)
+					{
+						// Stop rather than rewind, the next pass would fail too
+						printf("\nError preparing sweep step\n");
+						sInstance.bExitRequest = TRUE;
+						break;
+					}
+					if(!bPrepared)
+					{
+						break;
+					}
+
+					// The step itself is then just the prepared R0 write
+					if(!ADF435x_DEV_bCommit(&sDevice))
+					{
+						printf("\nError writing sweep step\n");
+						sInstance.bExitRequest = TRUE;
+						break;
+					}
+					f = fNext;
+
+					// Get the next step's words out of the way while this one
+					// dwells, but only if they change nothing before its R0
+					bPrepared = SWEEP_bNextBuffered(&sPlan, &sDevice) && SWEEP_bPrepareNext(&sPlan, &sDevice, &fNext);
+				}
+
+				printf("\r %llu.%06lluMHz    ", (unsigned long long)f / 1000000, (unsigned long long)f % 1000000);
+
+				if(sInstance.iLockTimeout)
+				{
+					ADF435x_DEV_bWaitLock(&sDevice, sInstance.iLockTimeout * 1000ULL);
+				}
+
+				if(!PACER_bWait(&sPacer))
+				{
+					printf("\nExit requested\n");
+					sInstance.bExitRequest = TRUE;
+				}
+			}
+
+			if(!sInstance.bPipeline && sInstance.bIncremental && sStepper.bInvalid)
+			{
+				printf("\n%s\n", ADF435x_pcGetError(&sContext));
+				sInstance.bExitRequest = TRUE;
+			}
+		}
+
+		if(bSweepOk && sInstance.bPipeline)
+		{
+			PIPELINE_vStop(&sPipeline);
+		}
+
+		if(bSweepOk && sInstance.bIncremental)
+		{
+			SWEEP_vFreeStepper(&sStepper);
+		}
+		else if(bSweepOk && !sInstance.bPipeline)
+		{
+			SWEEP_vFreePlan(&sPlan);
+		}
+
+		PACER_vClose(&sPacer);
+
+		if(sPacer.u64Missed)
+		{
+			printf("\n%llu of %llu steps missed their slot\n",
+				(unsigned long long)sPacer.u64Missed, (unsigned long long)sPacer.u64Steps);
+		}
+
+		if(sPacer.u64MaxLatenessNs)
+		{
+			printf("\nStep lateness p50 %.1fus p99 %.1fus max %.1fus\n",
+				PACER_u64Lateness(&sPacer, 50) / 1000.0, PACER_u64Lateness(&sPacer, 99) / 1000.0,
+				PACER_u64Lateness(&sPacer, 100) / 1000.0);
+		}
+
+		if(sDevice.u64LockWaits)
+		{
+			printf("\nLock detect: %llu waits, %llu timeouts, mean %lluus max %lluus\n",
+				(unsigned long long)sDevice.u64LockWaits, (unsigned long long)sDevice.u64LockTimeouts,
+				(unsigned long long)(sDevice.u64LockWaitNs / sDevice.u64LockWaits) / 1000,
+				(unsigned long long)sDevice.u64MaxLockWaitNs / 1000);
 		}
 
 		// Switch the output off before we exit
 		sOptions.bOutputEnable = false;
-		bConfigureADF435x(&sOptions, 35000000);
+		ADF435x_bSetOptions(&sContext, &sOptions);
+		bConfigureADF435x(&sContext, 35000000);
+
+#ifndef _WIN32
+		if(iSignalFd >= 0)
+		{
+			close(iSignalFd);
+		}
+#endif
 	}
 	else
 	{
-		bConfigureADF435x(&sOptions, sInstance.u64Frequency);
+		bConfigureADF435x(&sContext, sInstance.u64Frequency);
 	}
 
-	CH341DeviceRelease();
+	sTransport.pfFlush(&sTransport);
+	sTransport.pfClose(&sTransport);
+
+	if(sInstance.bMock)
+	{
+		printf("\n%s transport: %llu writes, %llu bytes in %llu us\n", sTransport.pcName,
+			(unsigned long long)sMock.u64Writes, (unsigned long long)sMock.u64Bytes,
+			(unsigned long long)(sMock.u64LastNs - sMock.u64FirstNs) / 1000);
+		printf("Register words written %llu, skipped %llu\n",
+			(unsigned long long)sDevice.u64WordsWritten, (unsigned long long)sDevice.u64WordsSkipped);
+
+		if(sSim.u64Locks)
+		{
+			printf("Simulated ADF435x: %llu locks, last %.0fHz, command to lock mean %lluns max %lluns\n",
+				(unsigned long long)sSim.u64Locks, sSim.dOutputFrequencyHz,
+				(unsigned long long)(sSim.u64TotalLatencyNs / sSim.u64Locks),
+				(unsigned long long)sSim.u64MaxLatencyNs);
+		}
+	}
 
 	printf("\nDone!\n");
 
@@ -219,9 +596,7 @@ int main(int argc, char *argv[])
 static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *argv[])
 {
 
-	int n;
 	int c;
-	int index, value, from, to, port;
 
 	static const struct option lopts[] = {
 		{ "freq",			required_argument,	0, 	'f'	},
@@ -232,6 +607,19 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 		{ "high",			required_argument,	0, 	'h'	},
 		{ "resolution",		required_argument,	0, 	'r'	},
 		{ "delay",			required_argument,	0, 	'd'	},
+		{ "dwell",			required_argument,	0, 	'u'	},
+		{ "spin",			required_argument,	0, 	'j'	},
+		{ "realtime",		required_argument,	0, 	't'	},
+		{ "pipeline",		no_argument,		0, 	'P'	},
+		{ "daemon",			required_argument,	0, 	'D'	},
+		{ "drain",			required_argument,	0, 	'w'	},
+		{ "queue",			required_argument,	0, 	'q'	},
+		{ "mock",			no_argument,		0, 	'm'	},
+		{ "best",			no_argument,		0, 	'b'	},
+		{ "incremental",	no_argument,		0, 	'i'	},
+		{ "constant-mod",	no_argument,		0, 	'c'	},
+		{ "lock",			required_argument,	0, 	'k'	},
+		{ "lock-pin",		required_argument,	0, 	'p'	},
 
         { "verbosity",     	required_argument, 	0,  'v' },
 
@@ -244,7 +632,7 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 	while(1)
 	{
 
-		c = getopt_long(argc, argv, "f:sl:h:r:d:v:?:h:", lopts, NULL);
+		c = getopt_long(argc, argv, "f:sl:h:r:d:u:j:t:PD:w:q:mbick:p:v:?:h:", lopts, NULL);
 
 		if (c == -1)
 			break;
@@ -253,8 +641,8 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 		{
 
 		case 'f':
-			psInstance->u64Frequency = _atoi64(optarg);
-			printf("Frequency = %d.%dMHz\n", psInstance->u64Frequency / 1000000, psInstance->u64Frequency % 1000000);
+			psInstance->u64Frequency = strtoull(optarg, NULL, 10);
+			printf("Frequency = %llu.%06lluMHz\n", (unsigned long long)psInstance->u64Frequency / 1000000, (unsigned long long)psInstance->u64Frequency % 1000000);
 			break;
 
 		case 's':
@@ -263,23 +651,89 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 			break;
 
 		case 'l':
-			psInstance->u64FreqLow = _atoi64(optarg);
-			printf("Low Frequency = %d.%dMHz\n", psInstance->u64FreqLow / 1000000, psInstance->u64FreqLow % 1000000);
+			psInstance->u64FreqLow = strtoull(optarg, NULL, 10);
+			printf("Low Frequency = %llu.%06lluMHz\n", (unsigned long long)psInstance->u64FreqLow / 1000000, (unsigned long long)psInstance->u64FreqLow % 1000000);
 			break;
 
 		case 'h':
-			psInstance->u64FreqHigh = _atoi64(optarg);
-			printf("High Frequency = %d.%dMHz\n", psInstance->u64FreqHigh / 1000000, psInstance->u64FreqHigh % 1000000);
+			psInstance->u64FreqHigh = strtoull(optarg, NULL, 10);
+			printf("High Frequency = %llu.%06lluMHz\n", (unsigned long long)psInstance->u64FreqHigh / 1000000, (unsigned long long)psInstance->u64FreqHigh % 1000000);
 			break;
 
 		case 'r':
-			psInstance->u64FreqStep = _atoi64(optarg);
-			printf("Step Frequency = %d.%dMHz\n", psInstance->u64FreqStep / 1000000, psInstance->u64FreqStep % 1000000);
+			psInstance->u64FreqStep = strtoull(optarg, NULL, 10);
+			printf("Step Frequency = %llu.%06lluMHz\n", (unsigned long long)psInstance->u64FreqStep / 1000000, (unsigned long long)psInstance->u64FreqStep % 1000000);
 			break;
 
 		case 'd':
-			psInstance->iDelay = atoi(optarg);
-			printf("Step Delay = %dms\n", psInstance->iDelay);
+			psInstance->u64DwellUs = strtoull(optarg, NULL, 10) * 1000;
+			printf("Step Delay = %llums\n", (unsigned long long)psInstance->u64DwellUs / 1000);
+			break;
+
+		case 'u':
+			psInstance->u64DwellUs = strtoull(optarg, NULL, 10);
+			printf("Step Dwell = %lluus\n", (unsigned long long)psInstance->u64DwellUs);
+			break;
+
+		case 't':
+			psInstance->bRealtime = true;
+			psInstance->iRealtimeCpu = atoi(optarg);
+			printf("Realtime mode on CPU %d\n", psInstance->iRealtimeCpu);
+			break;
+
+		case 'D':
+			psInstance->pcDaemonPath = optarg;
+			printf("Daemon mode on %s\n", psInstance->pcDaemonPath);
+			break;
+
+		case 'P':
+			psInstance->bPipeline = true;
+			printf("Pipelined sweep enabled\n");
+			break;
+
+		case 'j':
+			psInstance->u64SpinUs = strtoull(optarg, NULL, 10);
+			printf("Spin for the last %lluus of each step\n", (unsigned long long)psInstance->u64SpinUs);
+			break;
+
+		case 'w':
+			psInstance->iDrainHops = atoi(optarg);
+			printf("Drain readback every %d hops\n", psInstance->iDrainHops);
+			break;
+
+		case 'q':
+			psInstance->iQueueDepth = atoi(optarg);
+			printf("USB queue depth = %d hops\n", psInstance->iQueueDepth);
+			break;
+
+		case 'm':
+			psInstance->bMock = true;
+			printf("Using mock SPI transport\n");
+			break;
+
+		case 'b':
+			psInstance->bBestFracMod = true;
+			printf("Best approximation FRAC/MOD enabled\n");
+			break;
+
+		case 'i':
+			psInstance->bIncremental = true;
+			printf("Incremental sweep enabled\n");
+			break;
+
+		case 'c':
+			psInstance->bConstantMod = true;
+			printf("Constant MOD sweep enabled\n");
+			break;
+
+		case 'k':
+			psInstance->iLockTimeout = atoi(optarg);
+			printf("Lock detect timeout = %dus\n", psInstance->iLockTimeout);
+			break;
+
+		case 'p':
+			psInstance->iLockPin = atoi(optarg);
+			printf("Lock detect on CH341 D%d\n", psInstance->iLockPin);
 			break;
 
 		case 'v':
@@ -315,6 +769,19 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 
 				"  -r --resolution <freq>           Set the sweep step frequency to <freq> Hz\n\n"
 				"  -d --delay <delay>               Set the sweep mode step delay to <delay> milliseconds\n\n"
+				"  -u --dwell <dwell>               Set the sweep mode step delay to <dwell> microseconds\n\n"
+				"  -j --spin <time>                 Sleep until <time> microseconds before each step, then spin\n\n"
+				"  -D --daemon <path>               Keep the device open and take commands on the Unix socket <path>\n\n"
+				"  -P --pipeline                    Calculate each step on a separate thread while the previous one is written\n\n"
+				"  -t --realtime <cpu>              Run the sweep pinned to <cpu> (-1 for any) at real time priority with memory locked\n\n"
+				"  -w --drain <hops>                Drain the CH341 SPI readback every <hops> hops (0 = every write), or sooner once 64 packets of readback are queued\n\n"
+				"  -q --queue <depth>               Keep up to <depth> hops in flight on the USB bus (0 = blocking)\n\n"
+				"  -m --mock                        Write to an in-memory mock device instead of the CH341\n\n"
+				"  -b --best                        Choose FRAC/MOD for the smallest frequency error\n\n"
+				"  -i --incremental                 Step the sweep by carry-add instead of precalculating it\n\n"
+				"  -c --constant-mod                Keep MOD fixed during the sweep so each step only writes R0\n\n"
+				"  -k --lock <timeout>              Step as soon as MUXOUT reports lock, waiting at most <timeout> microseconds\n\n"
+				"  -p --lock-pin <pin>              CH341 input D<pin> wired to MUXOUT (default 7)\n\n"
 				// "  -v --verbosity <level>           Set verbosity level 0, 1 & 2 are valid\n\n"
 				"  -? --help                        Display help\n\n"
 				);
@@ -355,55 +822,175 @@ static BOOL WINAPI bCtrlHandler(DWORD dwCtrlType)
         return FALSE;
     }
 }
+#else
+/****************************************************************************
+ *
+ * NAME: iInitSignals
+ *
+ * DESCRIPTION:
+ * Blocks SIGINT, SIGTERM and SIGHUP and returns a signalfd that becomes
+ * readable when one is pending, or -1 if that is not possible
+ *
+ * RETURNS:
+ * int
+ *
+ ****************************************************************************/
+static int iInitSignals(void)
+{
+	sigset_t sSignals;
+	int iFd;
+
+	sigemptyset(&sSignals);
+	sigaddset(&sSignals, SIGINT);
+	sigaddset(&sSignals, SIGTERM);
+	sigaddset(&sSignals, SIGHUP);
+
+	if(sigprocmask(SIG_BLOCK, &sSignals, NULL) < 0)
+	{
+		printf("Error blocking signals: %s\n", strerror(errno));
+		return -1;
+	}
+
+	iFd = signalfd(-1, &sSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if(iFd < 0)
+	{
+		printf("Error creating signalfd: %s\n", strerror(errno));
+		sigprocmask(SIG_UNBLOCK, &sSignals, NULL);
+	}
+
+	return iFd;
+}
 #endif
 
 
-bool bConfigureADF435x(ADF435x_tsOptions *psOptions, uint64_t u64FrequencyHz)
+/****************************************************************************
+ *
+ * NAME: vPollSignals
+ *
+ * DESCRIPTION:
+ * Requests exit if a blocked signal is pending on the signalfd, without
+ * waiting. The pacer only checks the signalfd while it waits, so this
+ * covers loops that never reach it
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void vPollSignals(void)
 {
+#ifndef _WIN32
+	struct signalfd_siginfo sInfo;
 
-	char acWord[4] = {0};
+	if(iSignalFd >= 0 && read(iSignalFd, &sInfo, sizeof(sInfo)) == sizeof(sInfo))
+	{
+		printf("\nExit requested\n");
+		sInstance.bExitRequest = TRUE;
+	}
+#endif
+}
 
-	ADF435X_tsSettings sSettings;
-	ADF435X_tuRegisters uRegisters;
 
-	// Generate calculated settings, exit if there is a problem
-	if(!ADF435x_bCalculateSettings(u64FrequencyHz, psOptions, &sSettings))
+/****************************************************************************
+ *
+ * NAME: bStepperSource
+ *
+ * DESCRIPTION:
+ * Pipeline source stepping the incremental sweep, wrapping at the end
+ *
+ * RETURNS:
+ * bool, false if a step is not valid
+ *
+ ****************************************************************************/
+static bool bStepperSource(void *pvUser, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency)
+{
+	SWEEP_tsStepper *psStepper = pvUser;
+
+	if(SWEEP_bStep(psStepper, puRegisters, pu64Frequency))
 	{
-		return false;
+		return true;
 	}
 
-	// Calculate the register values, exit if there is a problem
-	if(!ADF435x_bGenerateRegisters(psOptions, &sSettings, &uRegisters))
+	if(psStepper->bInvalid)
 	{
 		return false;
 	}
 
-	// All good if here so write the 6 registers in order R5, R4, R3, R2, R1 and R0
-	for(int n = 6; n > 0; n--)
+	SWEEP_vRewindStepper(psStepper);
+
+	return SWEEP_bStep(psStepper, puRegisters, pu64Frequency);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bCalculateSource
+ *
+ * DESCRIPTION:
+ * Pipeline source calculating each sweep step in full, wrapping at the end
+ *
+ * RETURNS:
+ * bool, false if a step is not valid
+ *
+ ****************************************************************************/
+static bool bCalculateSource(void *pvUser, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency)
+{
+	ADF435x_tsContext *psContext = pvUser;
+	ADF435X_tsSettings sSettings;
+
+	if(u64SourceFrequency > sInstance.u64FreqHigh)
 	{
-	
-		// printf("Sending %d - %08x\n", n-1, uRegisters.au32[n-1]);
+		u64SourceFrequency = sInstance.u64FreqLow;
+	}
 
-		acWord[0] = (uRegisters.au32[n-1] >> 24) & 0xff;
-		acWord[1] = (uRegisters.au32[n-1] >> 16) & 0xff;
-		acWord[2] = (uRegisters.au32[n-1] >> 8) & 0xff;
-		acWord[3] = (uRegisters.au32[n-1] >> 0) & 0xff;
+	*pu64Frequency = u64SourceFrequency;
+	u64SourceFrequency += sInstance.u64FreqStep;
 
-		if(!CH341ChipSelect(0, TRUE))
-		{
-			printf("Error at line %d\n", __LINE__);
-		}
+	return ADF435x_bCalculateSettings(psContext, *pu64Frequency, &sSettings) &&
+		   ADF435x_bGenerateRegisters(psContext, &sSettings, puRegisters);
+}
 
-		if(CH341WriteSPI(acWord, 4) <= 0)
-		{
-			printf("Error at line %d\n", __LINE__);
-		}
 
-		if(!CH341ChipSelect(0, FALSE))
-		{
-			printf("Error at line %d\n", __LINE__);
-		}
+/****************************************************************************
+ *
+ * NAME: bConfigureADF435x
+ *
+ * DESCRIPTION:
+ * Calculates the registers for u64FrequencyHz and writes whichever of them
+ * changed to the device
+ *
+ * RETURNS:
+ * bool, false if the frequency is not valid with the current options
+ *
+ ****************************************************************************/
+bool bConfigureADF435x(ADF435x_tsContext *psContext, uint64_t u64FrequencyHz)
+{
+
+	ADF435X_tsSettings sSettings;
+	ADF435X_tuRegisters uRegisters;
 
+	if(sInstance.bMock)
+	{
+		ADF435x_SIM_vCommand(&sSim);
+	}
+
+	// Generate calculated settings, exit if there is a problem
+	if(!ADF435x_bCalculateSettings(psContext, u64FrequencyHz, &sSettings))
+	{
+		printf("%s\n", ADF435x_pcGetError(psContext));
+		return false;
+	}
+
+	// Calculate the register values, exit if there is a problem
+	if(!ADF435x_bGenerateRegisters(psContext, &sSettings, &uRegisters))
+	{
+		printf("%s\n", ADF435x_pcGetError(psContext));
+		return false;
+	}
+
+	// All good if here so write whichever registers changed, R0 last
+	if(!ADF435x_DEV_bWriteRegisters(&sDevice, &uRegisters))
+	{
+		printf("Error at line %d\n", __LINE__);
 	}
 
 	return true;
@@ -0,0 +1,387 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+// ppoll() is a GNU extension
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include "transport.h"
+#include "pacer.h"
+
+static uint64_t PACER_u64SpinTimeNs(void);
+static void PACER_vNextDeadline(PACER_tsPacer *psPacer, uint64_t u64NowNs);
+static bool PACER_bSleep(PACER_tsPacer *psPacer, uint64_t u64DurationNs);
+static bool PACER_bWaitHybrid(PACER_tsPacer *psPacer, uint64_t *pu64LatenessNs);
+static bool PACER_bWaitTimer(PACER_tsPacer *psPacer, uint64_t *pu64LatenessNs);
+static bool PACER_bPollWake(PACER_tsPacer *psPacer);
+
+// Starts the schedule with the first step due one period from now. With a
+// period of 0 steps are not paced, and with a spin time of 0 the pacer only
+// sleeps. iWakeFd is -1 for none, and is not used on Windows.
+bool PACER_bInit(PACER_tsPacer *psPacer, uint64_t u64PeriodNs, uint64_t u64SpinNs, int iWakeFd)
+{
+    memset(psPacer, 0, sizeof(PACER_tsPacer));
+    psPacer->u64PeriodNs = u64PeriodNs;
+    psPacer->u64SpinNs = u64SpinNs;
+    psPacer->u64DeadlineNs = u64SpinNs ? PACER_u64SpinTimeNs() : TRANSPORT_u64TimeNs();
+
+#ifndef _WIN32
+    struct itimerspec sTimer;
+
+    psPacer->iTimerFd = -1;
+    psPacer->iWakeFd = iWakeFd;
+
+    if(u64PeriodNs == 0 || u64SpinNs)
+    {
+        return true;
+    }
+
+    // The timer is on CLOCK_MONOTONIC, as is TRANSPORT_u64TimeNs()
+    psPacer->iTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if(psPacer->iTimerFd < 0)
+    {
+        fprintf(stderr, "Error: timerfd_create failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    sTimer.it_interval.tv_sec = u64PeriodNs / 1000000000ULL;
+    sTimer.it_interval.tv_nsec = u64PeriodNs % 1000000000ULL;
+    sTimer.it_value.tv_sec = (psPacer->u64DeadlineNs + u64PeriodNs) / 1000000000ULL;
+    sTimer.it_value.tv_nsec = (psPacer->u64DeadlineNs + u64PeriodNs) % 1000000000ULL;
+
+    if(timerfd_settime(psPacer->iTimerFd, TFD_TIMER_ABSTIME, &sTimer, NULL) < 0)
+    {
+        fprintf(stderr, "Error: timerfd_settime failed: %s\n", strerror(errno));
+        PACER_vClose(psPacer);
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+// Blocks until the next step is due. Returns false if the wait was cut short
+// by the wake descriptor, or on error.
+bool PACER_bWait(PACER_tsPacer *psPacer)
+{
+    uint64_t u64LatenessNs;
+    bool bOk;
+
+    if(psPacer->u64PeriodNs == 0)
+    {
+        // Unpaced, only check the wake descriptor
+        psPacer->u64Steps++;
+        return PACER_bPollWake(psPacer);
+    }
+
+    if(psPacer->u64SpinNs)
+    {
+        bOk = PACER_bWaitHybrid(psPacer, &u64LatenessNs);
+    }
+    else
+    {
+        bOk = PACER_bWaitTimer(psPacer, &u64LatenessNs);
+    }
+
+    if(!bOk)
+    {
+        return false;
+    }
+
+    psPacer->au32Lateness[u64LatenessNs / PACER_LATENESS_BIN_NS < PACER_LATENESS_BINS ?
+                          u64LatenessNs / PACER_LATENESS_BIN_NS : PACER_LATENESS_BINS]++;
+    if(u64LatenessNs > psPacer->u64MaxLatenessNs)
+    {
+        psPacer->u64MaxLatenessNs = u64LatenessNs;
+    }
+
+    psPacer->u64Steps++;
+
+    return true;
+}
+
+// Lateness not exceeded by uPercentile percent of the paced steps, to the
+// resolution of the histogram. The maximum is exact.
+uint64_t PACER_u64Lateness(PACER_tsPacer *psPacer, unsigned int uPercentile)
+{
+    uint64_t u64Total = 0;
+    uint64_t u64Count = 0;
+    uint64_t u64Target;
+
+    for(unsigned int n = 0; n <= PACER_LATENESS_BINS; n++)
+    {
+        u64Total += psPacer->au32Lateness[n];
+    }
+
+    if(u64Total == 0)
+    {
+        return 0;
+    }
+
+    if(uPercentile >= 100)
+    {
+        return psPacer->u64MaxLatenessNs;
+    }
+
+    u64Target = (u64Total * uPercentile + 99) / 100;
+
+    for(unsigned int n = 0; n < PACER_LATENESS_BINS; n++)
+    {
+        u64Count += psPacer->au32Lateness[n];
+        if(u64Count >= u64Target)
+        {
+            return (uint64_t)(n + 1) * PACER_LATENESS_BIN_NS;
+        }
+    }
+
+    return psPacer->u64MaxLatenessNs;
+}
+
+void PACER_vClose(PACER_tsPacer *psPacer)
+{
+#ifndef _WIN32
+    if(psPacer->iTimerFd >= 0)
+    {
+        close(psPacer->iTimerFd);
+        psPacer->iTimerFd = -1;
+    }
+#endif
+}
+
+// Clock used to spin on. CLOCK_MONOTONIC_RAW is not slewed by NTP, so short
+// intervals measured on it are true.
+static uint64_t PACER_u64SpinTimeNs(void)
+{
+#ifdef _WIN32
+    return TRANSPORT_u64TimeNs();
+#else
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &sNow);
+
+    return (uint64_t)sNow.tv_sec * 1000000000ULL + sNow.tv_nsec;
+#endif
+}
+
+// Moves the deadline on one period, skipping any slots that have already
+// passed
+static void PACER_vNextDeadline(PACER_tsPacer *psPacer, uint64_t u64NowNs)
+{
+    uint64_t u64Late;
+
+    psPacer->u64DeadlineNs += psPacer->u64PeriodNs;
+
+    if(u64NowNs >= psPacer->u64DeadlineNs + psPacer->u64PeriodNs)
+    {
+        u64Late = (u64NowNs - psPacer->u64DeadlineNs) / psPacer->u64PeriodNs;
+        psPacer->u64Missed += u64Late;
+        psPacer->u64DeadlineNs += u64Late * psPacer->u64PeriodNs;
+    }
+}
+
+// Relative sleep that returns false early if the wake descriptor becomes
+// readable
+static bool PACER_bSleep(PACER_tsPacer *psPacer, uint64_t u64DurationNs)
+{
+#ifdef _WIN32
+    // Round down, the spin makes up the rest
+    Sleep((DWORD)(u64DurationNs / 1000000));
+
+    return true;
+#else
+    struct timespec sDuration;
+    struct pollfd sFd;
+
+    sDuration.tv_sec = u64DurationNs / 1000000000ULL;
+    sDuration.tv_nsec = u64DurationNs % 1000000000ULL;
+
+    if(psPacer->iWakeFd < 0)
+    {
+        clock_nanosleep(CLOCK_MONOTONIC, 0, &sDuration, NULL);
+        return true;
+    }
+
+    sFd.fd = psPacer->iWakeFd;
+    sFd.events = POLLIN;
+    sFd.revents = 0;
+
+    // An interrupted sleep is made up by the spin
+    if(ppoll(&sFd, 1, &sDuration, NULL) < 0 && errno != EINTR)
+    {
+        fprintf(stderr, "Error: ppoll failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    return sFd.revents == 0;
+#endif
+}
+
+static bool PACER_bWaitHybrid(PACER_tsPacer *psPacer, uint64_t *pu64LatenessNs)
+{
+    uint64_t u64NowNs = PACER_u64SpinTimeNs();
+
+    PACER_vNextDeadline(psPacer, u64NowNs);
+
+    // Sleep until shortly before the deadline
+    if(u64NowNs + psPacer->u64SpinNs < psPacer->u64DeadlineNs)
+    {
+        if(!PACER_bSleep(psPacer, psPacer->u64DeadlineNs - psPacer->u64SpinNs - u64NowNs))
+        {
+            return false;
+        }
+    }
+    else if(!PACER_bPollWake(psPacer))
+    {
+        // Too close to sleep, which is every step when the spin time is at
+        // least the period, so check the wake descriptor here instead
+        return false;
+    }
+
+    // then spin the rest of the way
+    do
+    {
+        u64NowNs = PACER_u64SpinTimeNs();
+    } while(u64NowNs < psPacer->u64DeadlineNs);
+
+    *pu64LatenessNs = u64NowNs - psPacer->u64DeadlineNs;
+
+    return true;
+}
+
+static bool PACER_bWaitTimer(PACER_tsPacer *psPacer, uint64_t *pu64LatenessNs)
+{
+#ifdef _WIN32
+    uint64_t u64NowNs = TRANSPORT_u64TimeNs();
+
+    PACER_vNextDeadline(psPacer, u64NowNs);
+
+    if(u64NowNs < psPacer->u64DeadlineNs)
+    {
+        // Round up so the step is never early, Sleep() only has millisecond
+        // resolution
+        Sleep((DWORD)((psPacer->u64DeadlineNs - u64NowNs + 999999) / 1000000));
+        u64NowNs = TRANSPORT_u64TimeNs();
+    }
+
+    *pu64LatenessNs = u64NowNs > psPacer->u64DeadlineNs ? u64NowNs - psPacer->u64DeadlineNs : 0;
+
+    return true;
+#else
+    struct pollfd asFds[2];
+    nfds_t uFds = 1;
+    uint64_t u64Expirations;
+    uint64_t u64NowNs;
+
+    asFds[0].fd = psPacer->iTimerFd;
+    asFds[0].events = POLLIN;
+
+    if(psPacer->iWakeFd >= 0)
+    {
+        asFds[1].fd = psPacer->iWakeFd;
+        asFds[1].events = POLLIN;
+        uFds++;
+    }
+
+    for(;;)
+    {
+        asFds[0].revents = 0;
+        asFds[1].revents = 0;
+
+        if(poll(asFds, uFds, -1) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "Error: poll failed: %s\n", strerror(errno));
+            return false;
+        }
+
+        if(uFds > 1 && asFds[1].revents)
+        {
+            return false;
+        }
+
+        if(asFds[0].revents)
+        {
+            // The expiration count says how many slots have passed
+            if(read(psPacer->iTimerFd, &u64Expirations, sizeof(u64Expirations)) != sizeof(u64Expirations))
+            {
+                if(errno == EINTR || errno == EAGAIN)
+                {
+                    continue;
+                }
+                fprintf(stderr, "Error: timerfd read failed: %s\n", strerror(errno));
+                return false;
+            }
+
+            u64NowNs = TRANSPORT_u64TimeNs();
+
+            psPacer->u64Missed += u64Expirations - 1;
+            psPacer->u64DeadlineNs += u64Expirations * psPacer->u64PeriodNs;
+            *pu64LatenessNs = u64NowNs > psPacer->u64DeadlineNs ? u64NowNs - psPacer->u64DeadlineNs : 0;
+
+            return true;
+        }
+    }
+#endif
+}
+
+// Returns false if the wake descriptor is readable
+static bool PACER_bPollWake(PACER_tsPacer *psPacer)
+{
+#ifndef _WIN32
+    struct pollfd sFd;
+
+    if(psPacer->iWakeFd < 0)
+    {
+        return true;
+    }
+
+    sFd.fd = psPacer->iWakeFd;
+    sFd.events = POLLIN;
+    sFd.revents = 0;
+
+    if(poll(&sFd, 1, 0) < 0 && errno != EINTR)
+    {
+        fprintf(stderr, "Error: poll failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    return sFd.revents == 0;
+#else
+    return true;
+#endif
+}
@@ -0,0 +1,66 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Step lateness histogram, anything later than the last bin is counted in
+// an overflow bin
+#define PACER_LATENESS_BIN_NS       (100)
+#define PACER_LATENESS_BINS         (10000)
+
+// Paces sweep steps against an absolute schedule, step n is due at
+// start + n * period, so the time spent on each step does not accumulate
+// into drift. A step that misses its slot is not made up, the next one
+// is due at the following slot.
+//
+// With a spin time the pacer sleeps until that long before each deadline,
+// then busy waits on the raw monotonic clock, trading a CPU core for
+// wakeups that are not at the mercy of the scheduler.
+typedef struct {
+    uint64_t u64PeriodNs;
+    uint64_t u64SpinNs;
+    uint64_t u64DeadlineNs;
+
+    uint64_t u64Steps;
+    uint64_t u64Missed;
+
+    // How late each step was released after its deadline
+    uint32_t au32Lateness[PACER_LATENESS_BINS + 1];
+    uint64_t u64MaxLatenessNs;
+
+#ifndef _WIN32
+    // Periodic timer, and an optional descriptor that cuts a wait short
+    // when it becomes readable, such as a signalfd
+    int iTimerFd;
+    int iWakeFd;
+#endif
+} PACER_tsPacer;
+
+bool PACER_bInit(PACER_tsPacer *psPacer, uint64_t u64PeriodNs, uint64_t u64SpinNs, int iWakeFd);
+bool PACER_bWait(PACER_tsPacer *psPacer);
+uint64_t PACER_u64Lateness(PACER_tsPacer *psPacer, unsigned int uPercentile);
+void PACER_vClose(PACER_tsPacer *psPacer);
+
+#endif // _PACER_H_
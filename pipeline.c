@@ -0,0 +1,182 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+#include "adf435x_dev.h"
+#include "pipeline.h"
+
+static void *PIPELINE_pvProducer(void *pvArg);
+
+// Starts the producer thread. The ring is filled from the first step, which
+// is a full register set R5 to R0, every later frame holds only the words
+// that hop needs.
+bool PIPELINE_bStart(PIPELINE_tsPipeline *psPipeline, PIPELINE_tpfSource pfSource, void *pvUser)
+{
+    memset(psPipeline, 0, sizeof(PIPELINE_tsPipeline));
+    atomic_init(&psPipeline->uHead, 0);
+    atomic_init(&psPipeline->uTail, 0);
+    atomic_init(&psPipeline->bStop, false);
+    atomic_init(&psPipeline->bDone, false);
+    psPipeline->pfSource = pfSource;
+    psPipeline->pvUser = pvUser;
+
+    if(pthread_create(&psPipeline->sThread, NULL, PIPELINE_pvProducer, psPipeline))
+    {
+        printf("Error creating pipeline thread\n");
+        return false;
+    }
+
+    psPipeline->bStarted = true;
+
+    return true;
+}
+
+// Takes the next frame, waiting for the producer if the ring is empty.
+// Returns false once the producer has finished and the ring is drained.
+// The wait yields, then sleeps, like the producer's: in realtime mode the
+// consumer runs at SCHED_FIFO priority, where a yield never lets an
+// ordinary thread on the same CPU run, so the producer could otherwise be
+// starved of the CPU the consumer is waiting on.
+bool PIPELINE_bPop(PIPELINE_tsPipeline *psPipeline, PIPELINE_tsFrame *psFrame)
+{
+    size_t uTail = atomic_load_explicit(&psPipeline->uTail, memory_order_relaxed);
+    unsigned int uSpins = 0;
+    const struct timespec sBackoff = {0, PIPELINE_BACKOFF_NS};
+
+    if(uTail == psPipeline->uCachedHead)
+    {
+        psPipeline->uCachedHead = atomic_load_explicit(&psPipeline->uHead, memory_order_acquire);
+
+        while(uTail == psPipeline->uCachedHead)
+        {
+            if(atomic_load_explicit(&psPipeline->bDone, memory_order_acquire))
+            {
+                // The producer may have pushed a last frame before finishing
+                psPipeline->uCachedHead = atomic_load_explicit(&psPipeline->uHead, memory_order_acquire);
+                if(uTail == psPipeline->uCachedHead)
+                {
+                    return false;
+                }
+                break;
+            }
+
+            psPipeline->u64Empty++;
+            if(++uSpins < PIPELINE_SPINS)
+            {
+                sched_yield();
+            }
+            else
+            {
+                nanosleep(&sBackoff, NULL);
+            }
+            psPipeline->uCachedHead = atomic_load_explicit(&psPipeline->uHead, memory_order_acquire);
+        }
+    }
+
+    *psFrame = psPipeline->asFrames[uTail & (PIPELINE_CAPACITY - 1)];
+    atomic_store_explicit(&psPipeline->uTail, uTail + 1, memory_order_release);
+
+    return true;
+}
+
+// Stops the producer and waits for it to finish. Frames still in the ring
+// are discarded.
+void PIPELINE_vStop(PIPELINE_tsPipeline *psPipeline)
+{
+    if(!psPipeline->bStarted)
+    {
+        return;
+    }
+
+    atomic_store_explicit(&psPipeline->bStop, true, memory_order_release);
+    pthread_join(psPipeline->sThread, NULL);
+    psPipeline->bStarted = false;
+}
+
+static void *PIPELINE_pvProducer(void *pvArg)
+{
+    PIPELINE_tsPipeline *psPipeline = pvArg;
+    ADF435X_tuRegisters uRegisters;
+    PIPELINE_tsFrame *psFrame;
+    size_t uHead = 0;
+    unsigned int uSpins = 0;
+    bool bFirst = true;
+    const struct timespec sBackoff = {0, PIPELINE_BACKOFF_NS};
+
+    while(!atomic_load_explicit(&psPipeline->bStop, memory_order_relaxed))
+    {
+        // Wait for a free slot
+        if(uHead - psPipeline->uCachedTail == PIPELINE_CAPACITY)
+        {
+            psPipeline->uCachedTail = atomic_load_explicit(&psPipeline->uTail, memory_order_acquire);
+            if(uHead - psPipeline->uCachedTail == PIPELINE_CAPACITY)
+            {
+                // The consumer is paced, so once the ring is full there
+                // can be a whole dwell to wait. Spin briefly, then back off
+                // rather than hold a CPU.
+                psPipeline->u64Full++;
+                if(++uSpins < PIPELINE_SPINS)
+                {
+                    sched_yield();
+                }
+                else
+                {
+                    nanosleep(&sBackoff, NULL);
+                }
+                continue;
+            }
+        }
+
+        uSpins = 0;
+
+        psFrame = &psPipeline->asFrames[uHead & (PIPELINE_CAPACITY - 1)];
+
+        if(!psPipeline->pfSource(psPipeline->pvUser, &uRegisters, &psFrame->u64Frequency))
+        {
+            break;
+        }
+
+        if(bFirst)
+        {
+            for(psFrame->uCount = 0; psFrame->uCount < 6; psFrame->uCount++)
+            {
+                psFrame->au32Words[psFrame->uCount] = uRegisters.au32[5 - psFrame->uCount];
+            }
+            bFirst = false;
+        }
+        else
+        {
+            psFrame->uCount = ADF435x_DEV_uHopWords(&psPipeline->uPrevious, &uRegisters, psFrame->au32Words);
+        }
+
+        psPipeline->uPrevious = uRegisters;
+
+        atomic_store_explicit(&psPipeline->uHead, ++uHead, memory_order_release);
+    }
+
+    atomic_store_explicit(&psPipeline->bDone, true, memory_order_release);
+
+    return NULL;
+}
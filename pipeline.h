@@ -0,0 +1,85 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "adf435x.h"
+
+// Frames in the ring, a power of two
+#define PIPELINE_CAPACITY           (1024)
+#define PIPELINE_CACHE_LINE         (64)
+
+// Yields before either side sleeps on a full or empty ring, and how long
+// it sleeps
+#define PIPELINE_SPINS              (64)
+#define PIPELINE_BACKOFF_NS         (50000)
+
+// One hop, the words to write in order and the frequency they give
+typedef struct {
+    uint64_t u64Frequency;
+    uint32_t au32Words[6];
+    unsigned int uCount;
+} PIPELINE_tsFrame;
+
+// Produces the register set for the next step. Returns false to end the
+// pipeline, e.g. on a calculation error.
+typedef bool (*PIPELINE_tpfSource)(void *pvUser, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency);
+
+// Two stage pipeline. A producer thread calls the source and pushes the hop
+// words into a single producer, single consumer ring, while the consumer
+// pops them and writes them to the device, so register calculation and USB
+// latency overlap instead of adding up. The indices are lock free, each on
+// its own cache line with the other side's index cached alongside, so the
+// two threads only share a line when one has to catch up with the other.
+typedef struct {
+    // Producer side
+    _Alignas(PIPELINE_CACHE_LINE) atomic_size_t uHead;
+    size_t uCachedTail;
+    uint64_t u64Full;
+
+    // Consumer side
+    _Alignas(PIPELINE_CACHE_LINE) atomic_size_t uTail;
+    size_t uCachedHead;
+    uint64_t u64Empty;
+
+    _Alignas(PIPELINE_CACHE_LINE) atomic_bool bStop;
+    atomic_bool bDone;
+
+    PIPELINE_tpfSource pfSource;
+    void *pvUser;
+    ADF435X_tuRegisters uPrevious;
+    bool bStarted;
+    pthread_t sThread;
+
+    _Alignas(PIPELINE_CACHE_LINE) PIPELINE_tsFrame asFrames[PIPELINE_CAPACITY];
+} PIPELINE_tsPipeline;
+
+bool PIPELINE_bStart(PIPELINE_tsPipeline *psPipeline, PIPELINE_tpfSource pfSource, void *pvUser);
+bool PIPELINE_bPop(PIPELINE_tsPipeline *psPipeline, PIPELINE_tsFrame *psFrame);
+void PIPELINE_vStop(PIPELINE_tsPipeline *psPipeline);
+
+#endif // _PIPELINE_H_
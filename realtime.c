@@ -0,0 +1,149 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "realtime.h"
+
+static void REALTIME_vPrefaultStack(void);
+
+// Moves the calling thread out of the way of everything else on the box:
+// pinned to iCpu (unless it is negative), at real time priority, with every
+// page of the process locked in memory. Each step is tried in turn and any
+// that can not be had is reported, the rest still apply. Returns true only
+// if all of them succeeded.
+bool REALTIME_bEnter(int iCpu)
+{
+    bool bOk = true;
+
+#ifdef _WIN32
+    if(iCpu >= 0 && !SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << iCpu))
+    {
+        printf("Realtime: could not pin to CPU %d (error %lu)\n", iCpu, (unsigned long)GetLastError());
+        bOk = false;
+    }
+
+    // Without the privilege for the real time class Windows quietly gives
+    // high priority instead
+    if(!SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS) ||
+       GetPriorityClass(GetCurrentProcess()) != REALTIME_PRIORITY_CLASS)
+    {
+        printf("Realtime: could not enter the real time priority class\n");
+        bOk = false;
+    }
+
+    if(!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        printf("Realtime: could not raise thread priority (error %lu)\n", (unsigned long)GetLastError());
+        bOk = false;
+    }
+
+    printf("Realtime: memory locking is not supported on Windows\n");
+    bOk = false;
+#else
+    cpu_set_t sCpus;
+    struct sched_param sParam;
+
+    if(iCpu >= 0)
+    {
+        CPU_ZERO(&sCpus);
+        CPU_SET(iCpu, &sCpus);
+
+        if(sched_setaffinity(0, sizeof(sCpus), &sCpus) < 0)
+        {
+            printf("Realtime: could not pin to CPU %d: %s\n", iCpu, strerror(errno));
+            bOk = false;
+        }
+    }
+
+    memset(&sParam, 0, sizeof(sParam));
+    sParam.sched_priority = REALTIME_PRIORITY;
+
+    if(sched_setscheduler(0, SCHED_FIFO, &sParam) < 0)
+    {
+        printf("Realtime: could not set SCHED_FIFO priority %d: %s\n", REALTIME_PRIORITY, strerror(errno));
+        bOk = false;
+    }
+
+    // Lock what is mapped now and anything mapped later, so a page fault
+    // can not stall a step
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+    {
+        printf("Realtime: could not lock memory: %s\n", strerror(errno));
+        bOk = false;
+    }
+#endif
+
+    REALTIME_vPrefaultStack();
+
+    return bOk;
+}
+
+// Touches every page of a buffer so it is resident before the first hop
+void REALTIME_vPrefault(const void *pvData, size_t uSize)
+{
+    const volatile unsigned char *pu8Data = pvData;
+    size_t uPage;
+
+#ifdef _WIN32
+    SYSTEM_INFO sInfo;
+
+    GetSystemInfo(&sInfo);
+    uPage = sInfo.dwPageSize;
+#else
+    uPage = sysconf(_SC_PAGESIZE);
+#endif
+
+    if(pvData == NULL || uSize == 0)
+    {
+        return;
+    }
+
+    for(size_t n = 0; n < uSize; n += uPage)
+    {
+        (void)pu8Data[n];
+    }
+    (void)pu8Data[uSize - 1];
+}
+
+static void REALTIME_vPrefaultStack(void)
+{
+    volatile unsigned char au8Stack[REALTIME_PREFAULT_STACK];
+
+    for(size_t n = 0; n < sizeof(au8Stack); n += 1024)
+    {
+        au8Stack[n] = 0;
+    }
+}
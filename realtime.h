@@ -0,0 +1,38 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _REALTIME_H_
+#define _REALTIME_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// SCHED_FIFO priority of the sweep thread, high enough to preempt ordinary
+// work but below the kernel's own threaded interrupt handlers
+#define REALTIME_PRIORITY           (80)
+
+// Stack touched up front so the sweep loop never grows into a new page
+#define REALTIME_PREFAULT_STACK     (256 * 1024)
+
+bool REALTIME_bEnter(int iCpu);
+void REALTIME_vPrefault(const void *pvData, size_t uSize);
+
+#endif // _REALTIME_H_
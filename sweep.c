@@ -0,0 +1,628 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "sweep.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+// Points calculated per batch call by each worker
+#define SWEEP_CHUNK_POINTS      4096
+
+typedef struct {
+    SWEEP_tsPlan *psPlan;
+
+    // Private copy so workers never write to the same error buffer
+    ADF435x_tsContext sContext;
+    size_t uStart;
+    size_t uEnd;
+
+    uint32_t *pu32Words;
+    size_t uWords;
+    size_t uCapacity;
+
+    size_t uFirstInvalid;
+    bool bNoMemory;
+    bool bInline;
+} SWEEP_tsWorker;
+
+static void *SWEEP_pvWorker(void *pvArg);
+static bool SWEEP_bReserve(SWEEP_tsWorker *psWorker, size_t uWords);
+static unsigned int SWEEP_uCPUCount(void);
+static bool SWEEP_bReload(SWEEP_tsStepper *psStepper);
+static uint64_t SWEEP_u64GCD(uint64_t a, uint64_t b);
+
+// Calculates and validates every point of the sweep up front, storing only
+// the register changes between consecutive steps. The range is split across
+// uThreads workers (0 = one per CPU), each filling its own part of the step
+// counts and its own word list, which are joined in order afterwards. On
+// failure the reason is left in psContext.
+bool SWEEP_bCreatePlan(SWEEP_tsPlan *psPlan, ADF435x_tsContext *psContext, uint64_t u64FreqLow, uint64_t u64FreqHigh, uint64_t u64FreqStep, unsigned int uThreads)
+{
+    ADF435X_tsSettings sSettings;
+    SWEEP_tsWorker *pasWorkers;
+    pthread_t *pasThreads;
+    size_t uFirstInvalid;
+    unsigned int uInvalidWorker = 0;
+    size_t uWords = 0;
+    bool bOk = true;
+
+    memset(psPlan, 0, sizeof(SWEEP_tsPlan));
+
+    if(u64FreqStep == 0 || u64FreqHigh < u64FreqLow)
+    {
+        ADF435x_vSetError(psContext, "Sweep range is invalid.");
+        return false;
+    }
+
+    // Report any problem with the options once, before the workers start
+    if(!ADF435x_bCalculateSettings(psContext, u64FreqLow, &sSettings))
+    {
+        return false;
+    }
+
+    psPlan->u64FreqLow = u64FreqLow;
+    psPlan->u64FreqStep = u64FreqStep;
+    psPlan->uPoints = (size_t)((u64FreqHigh - u64FreqLow) / u64FreqStep) + 1;
+
+    if(uThreads == 0)
+    {
+        uThreads = SWEEP_uCPUCount();
+    }
+    if(uThreads > psPlan->uPoints / SWEEP_CHUNK_POINTS + 1)
+    {
+        uThreads = psPlan->uPoints / SWEEP_CHUNK_POINTS + 1;
+    }
+
+    psPlan->pu8Counts = malloc(psPlan->uPoints);
+    pasWorkers = calloc(uThreads, sizeof(SWEEP_tsWorker));
+    pasThreads = calloc(uThreads, sizeof(pthread_t));
+
+    if(psPlan->pu8Counts == NULL || pasWorkers == NULL || pasThreads == NULL)
+    {
+        ADF435x_vSetError(psContext, "Not enough memory for a sweep of %llu points.", (unsigned long long)psPlan->uPoints);
+        free(pasWorkers);
+        free(pasThreads);
+        SWEEP_vFreePlan(psPlan);
+        return false;
+    }
+
+    for(unsigned int n = 0; n < uThreads; n++)
+    {
+        pasWorkers[n].psPlan = psPlan;
+        pasWorkers[n].sContext = *psContext;
+        pasWorkers[n].uStart = (psPlan->uPoints * n) / uThreads;
+        pasWorkers[n].uEnd = (psPlan->uPoints * (n + 1)) / uThreads;
+
+        // Worker 0 runs on this thread
+        if(n != 0 && pthread_create(&pasThreads[n], NULL, SWEEP_pvWorker, &pasWorkers[n]) != 0)
+        {
+            SWEEP_pvWorker(&pasWorkers[n]);
+            pasWorkers[n].bInline = true;
+        }
+    }
+
+    SWEEP_pvWorker(&pasWorkers[0]);
+
+    for(unsigned int n = 1; n < uThreads; n++)
+    {
+        if(!pasWorkers[n].bInline)
+        {
+            pthread_join(pasThreads[n], NULL);
+        }
+    }
+
+    // Merge in range order so the result does not depend on scheduling, the
+    // lowest invalid point is the one reported
+    uFirstInvalid = psPlan->uPoints;
+    for(unsigned int n = 0; n < uThreads; n++)
+    {
+        if(pasWorkers[n].bNoMemory)
+        {
+            bOk = false;
+        }
+        if(pasWorkers[n].uFirstInvalid < uFirstInvalid)
+        {
+            uFirstInvalid = pasWorkers[n].uFirstInvalid;
+            uInvalidWorker = n;
+        }
+        uWords += pasWorkers[n].uWords;
+    }
+
+    if(uFirstInvalid != psPlan->uPoints)
+    {
+        ADF435x_vSetError(psContext, "Sweep point %llu Hz is not valid. %s", (unsigned long long)(u64FreqLow + uFirstInvalid * u64FreqStep),
+                          ADF435x_pcGetError(&pasWorkers[uInvalidWorker].sContext));
+        bOk = false;
+    }
+    else if(!bOk)
+    {
+        ADF435x_vSetError(psContext, "Not enough memory for a sweep of %llu points.", (unsigned long long)psPlan->uPoints);
+    }
+    else if((psPlan->pu32Words = malloc((uWords ? uWords : 1) * sizeof(uint32_t))) == NULL)
+    {
+        ADF435x_vSetError(psContext, "Not enough memory for a sweep of %llu points.", (unsigned long long)psPlan->uPoints);
+        bOk = false;
+    }
+    else
+    {
+        for(unsigned int n = 0; n < uThreads; n++)
+        {
+            memcpy(&psPlan->pu32Words[psPlan->uWords], pasWorkers[n].pu32Words, pasWorkers[n].uWords * sizeof(uint32_t));
+            psPlan->uWords += pasWorkers[n].uWords;
+        }
+    }
+
+    for(unsigned int n = 0; n < uThreads; n++)
+    {
+        free(pasWorkers[n].pu32Words);
+    }
+    free(pasWorkers);
+    free(pasThreads);
+
+    if(!bOk)
+    {
+        SWEEP_vFreePlan(psPlan);
+    }
+
+    return bOk;
+}
+
+void SWEEP_vFreePlan(SWEEP_tsPlan *psPlan)
+{
+    free(psPlan->pu8Counts);
+    free(psPlan->pu32Words);
+    psPlan->pu8Counts = NULL;
+    psPlan->pu32Words = NULL;
+    psPlan->uPoints = 0;
+}
+
+void SWEEP_vRewind(SWEEP_tsPlan *psPlan)
+{
+    psPlan->uIndex = 0;
+    psPlan->uWordIndex = 0;
+    psPlan->bError = false;
+}
+
+// Prepares the next step of the plan, ADF435x_DEV_bCommit() then changes the
+// frequency with a single R0 write. Returns false at the end of the pass or on
+// a write error, which also sets bError. Step 0 is prepared against the device
+// shadow so it is correct whatever state the device was left in.
+bool SWEEP_bPrepareNext(SWEEP_tsPlan *psPlan, ADF435X_DEV_tsDevice *psDevice, uint64_t *pu64Frequency)
+{
+    size_t n = psPlan->uIndex;
+    bool bOk;
+
+    if(n >= psPlan->uPoints)
+    {
+        return false;
+    }
+
+    if(n == 0)
+    {
+        bOk = ADF435x_DEV_bPrepare(psDevice, &psPlan->uFirst);
+    }
+    else
+    {
+        const uint32_t *pu32Words = &psPlan->pu32Words[psPlan->uWordIndex];
+
+        bOk = ADF435x_DEV_bPrepareWords(psDevice, pu32Words, psPlan->pu8Counts[n]);
+        psPlan->uWordIndex += psPlan->pu8Counts[n];
+    }
+
+    psPlan->uIndex++;
+
+    if(!bOk)
+    {
+        psPlan->bError = true;
+    }
+
+    if(pu64Frequency != NULL)
+    {
+        *pu64Frequency = psPlan->u64FreqLow + n * psPlan->u64FreqStep;
+    }
+
+    return bOk;
+}
+
+// True if the next step can be prepared while the current one dwells, as
+// its words only change fields that wait for its R0 write
+bool SWEEP_bNextBuffered(SWEEP_tsPlan *psPlan, ADF435X_DEV_tsDevice *psDevice)
+{
+    size_t n = psPlan->uIndex;
+
+    if(n == 0 || n >= psPlan->uPoints)
+    {
+        return false;
+    }
+
+    return ADF435x_DEV_bBuffered(psDevice, &psPlan->pu32Words[psPlan->uWordIndex], psPlan->pu8Counts[n]);
+}
+
+// Finds the smallest MOD that represents every step of the sweep exactly, for
+// use as u32FixedMod. Each point has N = f * R * (1 + T) * divider / PFD
+// numerator, so MOD must be a multiple of the PFD numerator divided by its
+// GCD with the first point and the step. The highest point has the smallest
+// output divider and so needs the largest MOD, which every other band's
+// MOD divides.
+bool SWEEP_bConstantMod(ADF435x_tsContext *psContext, uint64_t u64FreqLow, uint64_t u64FreqHigh, uint64_t u64FreqStep, uint32_t *pu32Mod)
+{
+    uint64_t u64FreqLast, u64Scale, u64Mod;
+    uint32_t u32Select = 0;
+
+    if(u64FreqStep == 0 || u64FreqHigh < u64FreqLow || psContext->u64PFDNumerator == 0)
+    {
+        ADF435x_vSetError(psContext, "Sweep range is invalid.");
+        return false;
+    }
+
+    u64FreqLast = u64FreqLow + ((u64FreqHigh - u64FreqLow) / u64FreqStep) * u64FreqStep;
+    while(u32Select < 6 && (2200000000ULL >> u32Select) > u64FreqLast)
+    {
+        u32Select++;
+    }
+
+    u64Scale = psContext->u64PFDDenominator *
+               (psContext->sOptions.eFeedbackSelect == E_ADF435X_FEEDBACK_SELECT_FUNDAMENTAL ? (1ULL << u32Select) : 1);
+
+    u64Mod = psContext->u64PFDNumerator / SWEEP_u64GCD(psContext->u64PFDNumerator, SWEEP_u64GCD(u64FreqLow, u64FreqStep) * u64Scale);
+
+    if(u64Mod > 4095)
+    {
+        ADF435x_vSetError(psContext, "The sweep needs a MOD of %llu to be exact, the most is 4095.", (unsigned long long)u64Mod);
+        return false;
+    }
+
+    *pu32Mod = (uint32_t)(u64Mod < 2 ? 2 : u64Mod);
+
+    return true;
+}
+
+// Sets up an incremental sweep from u64FreqLow to u64FreqHigh. The carry-add
+// path needs MOD to fit the register and the PFD to be in the Frac-N range,
+// otherwise every step falls back to ADF435x_bCalculateSettings().
+bool SWEEP_bInitStepper(SWEEP_tsStepper *psStepper, ADF435x_tsContext *psContext, uint64_t u64FreqLow, uint64_t u64FreqHigh, uint64_t u64FreqStep)
+{
+    ADF435x_tsOptions *psOptions = &psContext->sOptions;
+    uint64_t u64Mod = psContext->u64ChannelMod;
+
+    memset(psStepper, 0, sizeof(SWEEP_tsStepper));
+
+    if(u64FreqStep == 0 || u64FreqHigh < u64FreqLow)
+    {
+        ADF435x_vSetError(psContext, "Sweep range is invalid.");
+        return false;
+    }
+
+    psStepper->psContext = psContext;
+    psStepper->u64FreqLow = u64FreqLow;
+    psStepper->u64FreqHigh = u64FreqHigh;
+    psStepper->u64FreqStep = u64FreqStep;
+    psStepper->u64Mod = u64Mod;
+    psStepper->u64TwoPFDNumerator = 2 * psContext->u64PFDNumerator;
+
+    psStepper->bFallback = psOptions->bBestFracMod || u64Mod < 2 || u64Mod > 4095 || psContext->u64PFDFreqHz > 32000000;
+
+    if(!psStepper->bFallback)
+    {
+        psStepper->pu16ReducedFrac = malloc((size_t)u64Mod * sizeof(uint16_t));
+        psStepper->pu16ReducedMod = malloc((size_t)u64Mod * sizeof(uint16_t));
+        if(psStepper->pu16ReducedFrac == NULL || psStepper->pu16ReducedMod == NULL)
+        {
+            SWEEP_vFreeStepper(psStepper);
+            ADF435x_vSetError(psContext, "Not enough memory for a sweep.");
+            return false;
+        }
+
+        // Same reduction as ADF435x_bCalculateSettings(), done once per FRAC
+        for(uint64_t n = 0; n < u64Mod; n++)
+        {
+            uint64_t u64Div = psContext->bReduceFracMod ? SWEEP_u64GCD(u64Mod, n) : 1;
+
+            psStepper->pu16ReducedFrac[n] = (uint16_t)(n / u64Div);
+            psStepper->pu16ReducedMod[n] = (uint16_t)(u64Mod / u64Div == 1 ? 2 : u64Mod / u64Div);
+        }
+    }
+
+    SWEEP_vRewindStepper(psStepper);
+
+    return true;
+}
+
+void SWEEP_vFreeStepper(SWEEP_tsStepper *psStepper)
+{
+    free(psStepper->pu16ReducedFrac);
+    free(psStepper->pu16ReducedMod);
+    psStepper->pu16ReducedFrac = NULL;
+    psStepper->pu16ReducedMod = NULL;
+}
+
+void SWEEP_vRewindStepper(SWEEP_tsStepper *psStepper)
+{
+    psStepper->u64Frequency = psStepper->u64FreqLow;
+    psStepper->bStarted = false;
+    psStepper->bInvalid = false;
+}
+
+// Calculates the registers for the next step, returns false at the end of the
+// pass, or with bInvalid set and the reason in the context if the step can't
+// be represented.
+bool SWEEP_bStep(SWEEP_tsStepper *psStepper, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency)
+{
+    ADF435x_tsContext *psContext = psStepper->psContext;
+    ADF435X_tsSettings sSettings;
+    uint32_t u32Frac, u32Mod;
+
+    if(psStepper->bInvalid)
+    {
+        return false;
+    }
+
+    if(psStepper->bStarted)
+    {
+        if(psStepper->u64FreqHigh - psStepper->u64Frequency < psStepper->u64FreqStep)
+        {
+            return false;
+        }
+        psStepper->u64Frequency += psStepper->u64FreqStep;
+    }
+
+    if(pu64Frequency != NULL)
+    {
+        *pu64Frequency = psStepper->u64Frequency;
+    }
+
+    if(psStepper->bFallback)
+    {
+        psStepper->bStarted = true;
+        if(!ADF435x_bCalculateSettings(psContext, psStepper->u64Frequency, &sSettings) ||
+           !ADF435x_bGenerateRegisters(psContext, &sSettings, puRegisters))
+        {
+            psStepper->bInvalid = true;
+            return false;
+        }
+        return true;
+    }
+
+    if(!psStepper->bStarted || psStepper->u64Frequency >= psStepper->u64NextBand)
+    {
+        psStepper->bStarted = true;
+        if(!SWEEP_bReload(psStepper))
+        {
+            psStepper->bInvalid = true;
+            return false;
+        }
+    }
+    else
+    {
+        psStepper->u64Int += psStepper->u64StepInt;
+        psStepper->u64Frac += psStepper->u64StepFrac;
+        psStepper->u64Rem += psStepper->u64StepRem;
+        if(psStepper->u64Rem >= psStepper->u64TwoPFDNumerator)
+        {
+            psStepper->u64Rem -= psStepper->u64TwoPFDNumerator;
+            psStepper->u64Frac++;
+        }
+        if(psStepper->u64Frac >= psStepper->u64Mod)
+        {
+            psStepper->u64Frac -= psStepper->u64Mod;
+            psStepper->u64Int++;
+        }
+    }
+
+    if(psStepper->u64Int > 65535)
+    {
+        ADF435x_vSetError(psContext, "Sweep point %llu Hz is not valid. INT=%llu is out of range.",
+                          (unsigned long long)psStepper->u64Frequency, (unsigned long long)psStepper->u64Int);
+        psStepper->bInvalid = true;
+        return false;
+    }
+
+    u32Frac = psStepper->pu16ReducedFrac[psStepper->u64Frac];
+    u32Mod = psStepper->pu16ReducedMod[psStepper->u64Frac];
+
+    *puRegisters = psContext->uBase;
+    puRegisters->u32Register0 |= (uint32_t)psStepper->u64Int << 15 | u32Frac << 3;
+    puRegisters->u32Register1 |= u32Mod << 3;
+    puRegisters->u32Register2 |= (u32Frac != 0) << 8;
+    puRegisters->u32Register4 |= psStepper->u32Select << 20 | (uint32_t)psContext->u64BandSelectClockDivider << 12;
+
+    return true;
+}
+
+// Calculates points uStart to uEnd in chunks using the batch functions. Each
+// chunk also recalculates the point before it so the first delta of the
+// chunk can be formed without waiting for another worker.
+static void *SWEEP_pvWorker(void *pvArg)
+{
+    SWEEP_tsWorker *psWorker = pvArg;
+    SWEEP_tsPlan *psPlan = psWorker->psPlan;
+    ADF435X_tsSettingsBatch sBatch;
+    ADF435X_tuRegisters uPrevious;
+    ADF435X_tuRegisters uRegisters;
+    uint64_t au64Frequency[SWEEP_CHUNK_POINTS + 1];
+
+    psWorker->uFirstInvalid = psPlan->uPoints;
+
+    if(!ADF435x_bAllocBatch(&sBatch, SWEEP_CHUNK_POINTS + 1))
+    {
+        psWorker->bNoMemory = true;
+        return NULL;
+    }
+
+    for(size_t uChunk = psWorker->uStart; uChunk < psWorker->uEnd; uChunk += SWEEP_CHUNK_POINTS)
+    {
+        size_t uFirst = uChunk == 0 ? 0 : uChunk - 1;
+        size_t uLast = MIN(uChunk + SWEEP_CHUNK_POINTS, psWorker->uEnd);
+
+        for(size_t n = uFirst; n < uLast; n++)
+        {
+            au64Frequency[n - uFirst] = psPlan->u64FreqLow + n * psPlan->u64FreqStep;
+        }
+
+        sBatch.uCount = uLast - uFirst;
+        if(!ADF435x_bCalculateSettingsBatch(&psWorker->sContext, au64Frequency, &sBatch) ||
+           !ADF435x_bGenerateRegistersBatch(&psWorker->sContext, &sBatch))
+        {
+            psWorker->uFirstInvalid = uFirst + (sBatch.uFirstInvalid < sBatch.uCount ? sBatch.uFirstInvalid : 0);
+            break;
+        }
+
+        // Worst case every register of every point in the chunk changes
+        if(!SWEEP_bReserve(psWorker, (uLast - uChunk) * 6))
+        {
+            psWorker->bNoMemory = true;
+            break;
+        }
+
+        for(size_t n = uFirst; n < uLast; n++)
+        {
+            for(int i = 0; i < 6; i++)
+            {
+                uRegisters.au32[i] = sBatch.apu32Registers[i][n - uFirst];
+            }
+
+            if(n == 0)
+            {
+                psPlan->uFirst = uRegisters;
+                psPlan->pu8Counts[0] = 0;
+            }
+            else if(n >= uChunk)
+            {
+                psPlan->pu8Counts[n] = ADF435x_DEV_uHopWords(&uPrevious, &uRegisters, &psWorker->pu32Words[psWorker->uWords]);
+                psWorker->uWords += psPlan->pu8Counts[n];
+            }
+
+            uPrevious = uRegisters;
+        }
+    }
+
+    ADF435x_vFreeBatch(&sBatch);
+
+    return NULL;
+}
+
+static bool SWEEP_bReserve(SWEEP_tsWorker *psWorker, size_t uWords)
+{
+    uint32_t *pu32Words;
+    size_t uCapacity = psWorker->uCapacity ? psWorker->uCapacity : 1024;
+
+    if(psWorker->uWords + uWords <= psWorker->uCapacity)
+    {
+        return true;
+    }
+
+    while(uCapacity < psWorker->uWords + uWords)
+    {
+        uCapacity *= 2;
+    }
+
+    pu32Words = realloc(psWorker->pu32Words, uCapacity * sizeof(uint32_t));
+    if(pu32Words == NULL)
+    {
+        return false;
+    }
+
+    psWorker->pu32Words = pu32Words;
+    psWorker->uCapacity = uCapacity;
+
+    return true;
+}
+
+static unsigned int SWEEP_uCPUCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO sInfo;
+
+    GetSystemInfo(&sInfo);
+    return sInfo.dwNumberOfProcessors ? sInfo.dwNumberOfProcessors : 1;
+#else
+    long lCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return lCount > 0 ? (unsigned int)lCount : 1;
+#endif
+}
+
+// Exact calculation at the current frequency, which also sets the band and
+// the per step increments. With N = f * R * (1 + T) * divider / (Fref * (1 + D))
+// the rounded FRAC is floor((2 * MOD * N + 1) / 2) so the whole of
+// (2 * MOD * f * R * (1 + T) * divider + PFD numerator) / (2 * PFD numerator)
+// is tracked as quotient and remainder.
+static bool SWEEP_bReload(SWEEP_tsStepper *psStepper)
+{
+    ADF435x_tsContext *psContext = psStepper->psContext;
+    ADF435X_tsSettings sSettings;
+    uint64_t u64Scale, u64Num, u64Quotient;
+
+    // Checks everything that does not change within the band
+    if(!ADF435x_bCalculateSettings(psContext, psStepper->u64Frequency, &sSettings))
+    {
+        return false;
+    }
+
+    psStepper->u32Select = 0;
+    while(psStepper->u32Select < 6 && (2200000000ULL >> psStepper->u32Select) > psStepper->u64Frequency)
+    {
+        psStepper->u32Select++;
+    }
+    psStepper->u64NextBand = psStepper->u32Select ? 2200000000ULL >> (psStepper->u32Select - 1) : UINT64_MAX;
+
+    u64Scale = 2 * psStepper->u64Mod * psContext->u64PFDDenominator *
+               (psContext->sOptions.eFeedbackSelect == E_ADF435X_FEEDBACK_SELECT_FUNDAMENTAL ? (1ULL << psStepper->u32Select) : 1);
+
+    u64Num = psStepper->u64Frequency * u64Scale + psContext->u64PFDNumerator;
+    u64Quotient = u64Num / psStepper->u64TwoPFDNumerator;
+    psStepper->u64Rem = u64Num % psStepper->u64TwoPFDNumerator;
+    psStepper->u64Int = u64Quotient / psStepper->u64Mod;
+    psStepper->u64Frac = u64Quotient % psStepper->u64Mod;
+
+    u64Num = psStepper->u64FreqStep * u64Scale;
+    u64Quotient = u64Num / psStepper->u64TwoPFDNumerator;
+    psStepper->u64StepRem = u64Num % psStepper->u64TwoPFDNumerator;
+    psStepper->u64StepInt = u64Quotient / psStepper->u64Mod;
+    psStepper->u64StepFrac = u64Quotient % psStepper->u64Mod;
+
+    return true;
+}
+
+static uint64_t SWEEP_u64GCD(uint64_t a, uint64_t b)
+{
+    uint64_t t;
+
+    while(b != 0)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
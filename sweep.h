@@ -0,0 +1,103 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _SWEEP_H_
+#define _SWEEP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "adf435x.h"
+#include "adf435x_dev.h"
+
+// Precomputed sweep. Step 0 is kept as a full register set, every other step
+// as the words that differ from the step before it, in write order.
+typedef struct {
+    uint64_t u64FreqLow;
+    uint64_t u64FreqStep;
+    size_t uPoints;
+
+    ADF435X_tuRegisters uFirst;
+    uint8_t *pu8Counts;
+    uint32_t *pu32Words;
+    size_t uWords;
+
+    // Replay cursor
+    size_t uIndex;
+    size_t uWordIndex;
+
+    // Set when a step could not be written, as opposed to the end of a pass
+    bool bError;
+} SWEEP_tsPlan;
+
+// Incremental sweep. Within an output divider band N changes by the same
+// rational amount every step, so INT and FRAC are advanced by carry-add
+// instead of being recalculated. The exact calculation is only repeated
+// when the band changes.
+typedef struct {
+    ADF435x_tsContext *psContext;
+    uint64_t u64FreqLow;
+    uint64_t u64FreqHigh;
+    uint64_t u64FreqStep;
+
+    // Replay cursor
+    uint64_t u64Frequency;
+    bool bStarted;
+    bool bInvalid;
+
+    // Every step needs the full calculation, e.g. best approximation FRAC/MOD
+    bool bFallback;
+
+    // Current band, and the frequency at which the next one starts
+    uint32_t u32Select;
+    uint64_t u64NextBand;
+
+    // N * MOD as a mixed number, INT + FRAC / MOD + u64Rem / (2 * PFD numerator)
+    uint64_t u64Int;
+    uint64_t u64Frac;
+    uint64_t u64Rem;
+    uint64_t u64Mod;
+    uint64_t u64TwoPFDNumerator;
+
+    // Per step increments of the above
+    uint64_t u64StepInt;
+    uint64_t u64StepFrac;
+    uint64_t u64StepRem;
+
+    // FRAC and MOD reduced by their GCD, indexed by FRAC
+    uint16_t *pu16ReducedFrac;
+    uint16_t *pu16ReducedMod;
+} SWEEP_tsStepper;
+
+bool SWEEP_bCreatePlan(SWEEP_tsPlan *psPlan, ADF435x_tsContext *psContext, uint64_t u64FreqLow, uint64_t u64FreqHigh, uint64_t u64FreqStep, unsigned int uThreads);
+void SWEEP_vFreePlan(SWEEP_tsPlan *psPlan);
+void SWEEP_vRewind(SWEEP_tsPlan *psPlan);
+bool SWEEP_bPrepareNext(SWEEP_tsPlan *psPlan, ADF435X_DEV_tsDevice *psDevice, uint64_t *pu64Frequency);
+bool SWEEP_bNextBuffered(SWEEP_tsPlan *psPlan, ADF435X_DEV_tsDevice *psDevice);
+
+bool SWEEP_bConstantMod(ADF435x_tsContext *psContext, uint64_t u64FreqLow, uint64_t u64FreqHigh, uint64_t u64FreqStep, uint32_t *pu32Mod);
+
+bool SWEEP_bInitStepper(SWEEP_tsStepper *psStepper, ADF435x_tsContext *psContext, uint64_t u64FreqLow, uint64_t u64FreqHigh, uint64_t u64FreqStep);
+void SWEEP_vFreeStepper(SWEEP_tsStepper *psStepper);
+void SWEEP_vRewindStepper(SWEEP_tsStepper *psStepper);
+bool SWEEP_bStep(SWEEP_tsStepper *psStepper, ADF435X_tuRegisters *puRegisters, uint64_t *pu64Frequency);
+
+#endif // _SWEEP_H_
@@ -0,0 +1,219 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libusb.h"
+#include "ch341.h"
+#include "fake_libusb.h"
+
+static struct libusb_transfer *apsSubmitted[FAKE_USB_MAX_SUBMITTED];
+static unsigned int uSubmitted;
+static unsigned long ulAllocations;
+static unsigned long ulWaits;
+static FAKE_USB_tsCapture *psActiveCapture;
+static int iHandle;
+
+void FAKE_USB_vCapture(FAKE_USB_tsCapture *psCapture)
+{
+    if(psCapture)
+    {
+        psCapture->uLength = 0;
+        psCapture->uTransfers = 0;
+        psCapture->bOverflow = false;
+    }
+    psActiveCapture = psCapture;
+}
+
+unsigned long FAKE_USB_ulAllocations(void)
+{
+    return ulAllocations;
+}
+
+unsigned long FAKE_USB_ulWaits(void)
+{
+    return ulWaits;
+}
+
+static void vRecord(const struct libusb_transfer *psTransfer)
+{
+    FAKE_USB_tsCapture *psCapture = psActiveCapture;
+
+    if(!psCapture)
+    {
+        return;
+    }
+
+    if(psCapture->uLength + psTransfer->length > psCapture->uCapacity || psCapture->uTransfers == psCapture->uMaxTransfers)
+    {
+        psCapture->bOverflow = true;
+        return;
+    }
+
+    memcpy(&psCapture->pu8Bytes[psCapture->uLength], psTransfer->buffer, psTransfer->length);
+    psCapture->uLength += psTransfer->length;
+    psCapture->puEnds[psCapture->uTransfers++] = psCapture->uLength;
+}
+
+int LIBUSB_CALL libusb_init(libusb_context **ctx)
+{
+    (void)ctx;
+    return 0;
+}
+
+void LIBUSB_CALL libusb_exit(libusb_context *ctx)
+{
+    (void)ctx;
+}
+
+const char * LIBUSB_CALL libusb_error_name(int errcode)
+{
+    (void)errcode;
+    return "FAKE";
+}
+
+libusb_device_handle * LIBUSB_CALL libusb_open_device_with_vid_pid(libusb_context *ctx, uint16_t vendor_id, uint16_t product_id)
+{
+    (void)ctx;
+    (void)vendor_id;
+    (void)product_id;
+    return (libusb_device_handle *)&iHandle;
+}
+
+void LIBUSB_CALL libusb_close(libusb_device_handle *dev_handle)
+{
+    (void)dev_handle;
+}
+
+int LIBUSB_CALL libusb_kernel_driver_active(libusb_device_handle *dev_handle, int interface_number)
+{
+    (void)dev_handle;
+    (void)interface_number;
+    return 0;
+}
+
+int LIBUSB_CALL libusb_detach_kernel_driver(libusb_device_handle *dev_handle, int interface_number)
+{
+    (void)dev_handle;
+    (void)interface_number;
+    return 0;
+}
+
+int LIBUSB_CALL libusb_claim_interface(libusb_device_handle *dev_handle, int interface_number)
+{
+    (void)dev_handle;
+    (void)interface_number;
+    return 0;
+}
+
+int LIBUSB_CALL libusb_release_interface(libusb_device_handle *dev_handle, int interface_number)
+{
+    (void)dev_handle;
+    (void)interface_number;
+    return 0;
+}
+
+int LIBUSB_CALL libusb_control_transfer(libusb_device_handle *dev_handle, uint8_t request_type, uint8_t bRequest,
+                                        uint16_t wValue, uint16_t wIndex, unsigned char *data, uint16_t wLength, unsigned int timeout)
+{
+    (void)dev_handle;
+    (void)request_type;
+    (void)bRequest;
+    (void)wValue;
+    (void)wIndex;
+    (void)timeout;
+    memset(data, 0, wLength);
+    return wLength;
+}
+
+struct libusb_transfer * LIBUSB_CALL libusb_alloc_transfer(int iso_packets)
+{
+    (void)iso_packets;
+    ulAllocations++;
+    return calloc(1, sizeof(struct libusb_transfer));
+}
+
+void LIBUSB_CALL libusb_free_transfer(struct libusb_transfer *transfer)
+{
+    free(transfer);
+}
+
+int LIBUSB_CALL libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+    if(uSubmitted == FAKE_USB_MAX_SUBMITTED)
+    {
+        return LIBUSB_ERROR_BUSY;
+    }
+
+    if(transfer->endpoint & LIBUSB_ENDPOINT_IN)
+    {
+        transfer->actual_length = transfer->length < CH341_PACKET_LENGTH - 1 ? transfer->length : CH341_PACKET_LENGTH - 1;
+    }
+    else
+    {
+        vRecord(transfer);
+        transfer->actual_length = transfer->length;
+    }
+    transfer->status = LIBUSB_TRANSFER_COMPLETED;
+    apsSubmitted[uSubmitted++] = transfer;
+
+    return 0;
+}
+
+int LIBUSB_CALL libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+    transfer->status = LIBUSB_TRANSFER_CANCELLED;
+    return 0;
+}
+
+int LIBUSB_CALL libusb_handle_events_timeout_completed(libusb_context *ctx, struct timeval *tv, int *completed)
+{
+    struct libusb_transfer *apsDone[FAKE_USB_MAX_SUBMITTED];
+    unsigned int uDone = uSubmitted;
+
+    (void)ctx;
+    (void)tv;
+    (void)completed;
+
+    ulWaits++;
+
+    // Callbacks may resubmit, those complete on the next call
+    memcpy(apsDone, apsSubmitted, uDone * sizeof(apsDone[0]));
+    uSubmitted = 0;
+
+    for(unsigned int n = 0; n < uDone; n++)
+    {
+        apsDone[n]->callback(apsDone[n]);
+    }
+
+    return 0;
+}
+
+int LIBUSB_CALL libusb_handle_events_completed(libusb_context *ctx, int *completed)
+{
+    return libusb_handle_events_timeout_completed(ctx, NULL, completed);
+}
+
+int LIBUSB_CALL libusb_handle_events(libusb_context *ctx)
+{
+    return libusb_handle_events_timeout_completed(ctx, NULL, NULL);
+}
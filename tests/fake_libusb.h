@@ -0,0 +1,58 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _FAKE_LIBUSB_H_
+#define _FAKE_LIBUSB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Just enough of libusb for the CH341 layer to run without a device.
+// Submitted transfers complete, in order, on the next call to handle events.
+// Writes complete in full, reads return one packet of SPI readback.
+
+// Maximum number of transfers in flight at once
+#define FAKE_USB_MAX_SUBMITTED          (128)
+
+// Records the bytes of every OUT transfer, back to back, and where each
+// transfer ends
+typedef struct {
+    unsigned char *pu8Bytes;
+    size_t uCapacity;
+    size_t uLength;
+
+    size_t *puEnds;
+    size_t uMaxTransfers;
+    size_t uTransfers;
+
+    bool bOverflow;
+} FAKE_USB_tsCapture;
+
+// Starts recording OUT transfers into psCapture, or stops if it is NULL
+void FAKE_USB_vCapture(FAKE_USB_tsCapture *psCapture);
+
+// Number of libusb_alloc_transfer() calls so far
+unsigned long FAKE_USB_ulAllocations(void);
+
+// Number of times the caller has waited on libusb events so far
+unsigned long FAKE_USB_ulWaits(void);
+
+#endif /* _FAKE_LIBUSB_H_ */
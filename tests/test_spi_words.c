@@ -0,0 +1,272 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+// Checks the stream CH341WriteSPIWords() sends against the one the original
+// per-register CH341ChipSelect() / CH341WriteSPI() / CH341ChipSelect()
+// sequence sends, both captured from the OUT endpoint of a fake libusb. Each
+// capture is split into packets as the CH341 parses them, into chip select
+// edges and the bytes clocked out on MOSI, and the OUT bytes are compared as
+// sent. Every chip select window must hold the same word bit for bit, after
+// the zero fill that right aligns it in its full length SPI packet.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ch341.h"
+#include "fake_libusb.h"
+
+#define TEST_CAPTURE_LENGTH     (4096)
+#define TEST_MAX_TRANSFERS      (64)
+#define TEST_EVENT_CAPACITY     (1024)
+#define TEST_FILL_BYTES         (CH341_PACKET_LENGTH - 1 - 4)
+
+#define TEST_EVENT_BYTE         (0)
+#define TEST_EVENT_CS_ASSERT    (1)
+#define TEST_EVENT_CS_DEASSERT  (2)
+
+typedef struct {
+    uint8_t u8Type;
+    uint8_t u8Byte;
+} tsEvent;
+
+typedef struct {
+    unsigned char au8Bytes[TEST_CAPTURE_LENGTH];
+    size_t auEnds[TEST_MAX_TRANSFERS];
+    FAKE_USB_tsCapture sCapture;
+    tsEvent asEvents[TEST_EVENT_CAPACITY];
+    size_t uEvents;
+} tsRecording;
+
+static const uint32_t au32Hop[6] = {
+    0x00580005, 0x00EC803C, 0x000004B3, 0x00004E42, 0x08008011, 0x00320000
+};
+
+static tsRecording sReference;
+static tsRecording sStream;
+
+static void vStartRecording(tsRecording *psRecording)
+{
+    psRecording->sCapture.pu8Bytes = psRecording->au8Bytes;
+    psRecording->sCapture.uCapacity = TEST_CAPTURE_LENGTH;
+    psRecording->sCapture.puEnds = psRecording->auEnds;
+    psRecording->sCapture.uMaxTransfers = TEST_MAX_TRANSFERS;
+    psRecording->uEvents = 0;
+    FAKE_USB_vCapture(&psRecording->sCapture);
+}
+
+static void vAddEvent(tsRecording *psRecording, uint8_t u8Type, uint8_t u8Byte)
+{
+    if(psRecording->uEvents < TEST_EVENT_CAPACITY)
+    {
+        psRecording->asEvents[psRecording->uEvents].u8Type = u8Type;
+        psRecording->asEvents[psRecording->uEvents].u8Byte = u8Byte;
+    }
+    psRecording->uEvents++;
+}
+
+// Decodes the captured OUT transfers into chip select edges and the bytes
+// sent for MOSI. The CH341 parses each transfer in 32 byte packets.
+static bool bDecode(tsRecording *psRecording)
+{
+    const FAKE_USB_tsCapture *psCapture = &psRecording->sCapture;
+    bool bSelected = false;
+    size_t uStart = 0;
+
+    if(psCapture->bOverflow)
+    {
+        printf("FAIL: capture overflow\n");
+        return false;
+    }
+
+    for(size_t uTransfer = 0; uTransfer < psCapture->uTransfers; uStart = psCapture->puEnds[uTransfer++])
+    {
+        for(size_t uPacket = uStart; uPacket < psCapture->puEnds[uTransfer]; uPacket += CH341_PACKET_LENGTH)
+        {
+            const unsigned char *pu8Packet = &psCapture->pu8Bytes[uPacket];
+            size_t uEnd = psCapture->puEnds[uTransfer] - uPacket < CH341_PACKET_LENGTH ? psCapture->puEnds[uTransfer] - uPacket : CH341_PACKET_LENGTH;
+
+            if(pu8Packet[0] == CH341_CMD_SPI_STREAM)
+            {
+                // Everything to the end of the packet is SPI data
+                for(size_t i = 1; i < uEnd; i++)
+                {
+                    vAddEvent(psRecording, TEST_EVENT_BYTE, pu8Packet[i]);
+                }
+            }
+            else if(pu8Packet[0] == CH341_CMD_UIO_STREAM)
+            {
+                for(size_t i = 1; i < uEnd && pu8Packet[i] != CH341_CMD_UIO_STM_END; i++)
+                {
+                    if((pu8Packet[i] & 0xC0) == CH341_CMD_UIO_STM_OUT)
+                    {
+                        bool bSelect = (pu8Packet[i] & 0x37) != 0x37;
+
+                        if(bSelect != bSelected)
+                        {
+                            vAddEvent(psRecording, bSelect ? TEST_EVENT_CS_ASSERT : TEST_EVENT_CS_DEASSERT, 0);
+                            bSelected = bSelect;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                printf("FAIL: unknown command 0x%02X at offset %zu\n", pu8Packet[0], uPacket);
+                return false;
+            }
+        }
+    }
+
+    if(psRecording->uEvents == 0 || psRecording->uEvents > TEST_EVENT_CAPACITY)
+    {
+        printf("FAIL: capture decoded to %zu events\n", psRecording->uEvents);
+        return false;
+    }
+
+    return true;
+}
+
+// Writes the words one register at a time, as main.c did before word streams
+static bool bWriteReference(unsigned int uCount)
+{
+    unsigned char acWord[4];
+
+    for(unsigned int n = 0; n < uCount; n++)
+    {
+        acWord[0] = (au32Hop[n] >> 24) & 0xff;
+        acWord[1] = (au32Hop[n] >> 16) & 0xff;
+        acWord[2] = (au32Hop[n] >> 8) & 0xff;
+        acWord[3] = (au32Hop[n] >> 0) & 0xff;
+
+        if(!CH341ChipSelect(0, true) || !CH341WriteSPI(acWord, 4) || !CH341ChipSelect(0, false))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool bCompare(unsigned int uCount)
+{
+    size_t uReference = 0;
+    size_t uStream = 0;
+
+    vStartRecording(&sReference);
+    if(!bWriteReference(uCount))
+    {
+        printf("FAIL: per-register write of %u words\n", uCount);
+        return false;
+    }
+
+    vStartRecording(&sStream);
+    if(!CH341WriteSPIWords(0, au32Hop, uCount))
+    {
+        printf("FAIL: stream write of %u words\n", uCount);
+        return false;
+    }
+    FAKE_USB_vCapture(NULL);
+
+    if(sStream.sCapture.uTransfers != 1)
+    {
+        printf("FAIL: %u words sent in %zu transfers\n", uCount, sStream.sCapture.uTransfers);
+        return false;
+    }
+
+    if(!bDecode(&sReference) || !bDecode(&sStream))
+    {
+        return false;
+    }
+
+    while(uReference < sReference.uEvents && uStream < sStream.uEvents)
+    {
+        const tsEvent *psReference = &sReference.asEvents[uReference];
+        const tsEvent *psStream = &sStream.asEvents[uStream];
+
+        if(psReference->u8Type != TEST_EVENT_BYTE || psStream->u8Type != TEST_EVENT_BYTE)
+        {
+            if(psReference->u8Type != psStream->u8Type)
+            {
+                printf("FAIL: %u words, chip select edge mismatch at reference event %zu\n", uCount, uReference);
+                return false;
+            }
+            uReference++;
+            uStream++;
+
+            // The stream clocks the fill ahead of the word in each window
+            if(psReference->u8Type == TEST_EVENT_CS_ASSERT)
+            {
+                for(int i = 0; i < TEST_FILL_BYTES; i++, uStream++)
+                {
+                    if(uStream >= sStream.uEvents ||
+                       sStream.asEvents[uStream].u8Type != TEST_EVENT_BYTE || sStream.asEvents[uStream].u8Byte != 0)
+                    {
+                        printf("FAIL: %u words, fill byte %d missing at stream event %zu\n", uCount, i, uStream);
+                        return false;
+                    }
+                }
+            }
+            continue;
+        }
+
+        if(psReference->u8Byte != psStream->u8Byte)
+        {
+            printf("FAIL: %u words, byte 0x%02X should be 0x%02X at reference event %zu\n", uCount, psStream->u8Byte, psReference->u8Byte, uReference);
+            return false;
+        }
+        uReference++;
+        uStream++;
+    }
+
+    if(uReference != sReference.uEvents || uStream != sStream.uEvents)
+    {
+        printf("FAIL: %u words, %zu of %zu reference events and %zu of %zu stream events matched\n",
+               uCount, uReference, sReference.uEvents, uStream, sStream.uEvents);
+        return false;
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    int iFailed = 0;
+
+    if(!CH341DeviceInit())
+    {
+        printf("FAIL: device init\n");
+        return 1;
+    }
+
+    for(unsigned int uCount = 1; uCount <= 6; uCount++)
+    {
+        if(!bCompare(uCount))
+        {
+            iFailed++;
+        }
+    }
+
+    CH341DeviceRelease();
+
+    printf("%s\n", iFailed ? "FAILED" : "PASSED");
+
+    return iFailed ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+// Runs the blocking, asynchronous and prepared CH341 write paths against a
+// fake libusb and checks that no transfer is allocated once the device is
+// open, both by the count CH341TransferAllocations() keeps and by the fake's
+// own count of libusb_alloc_transfer() calls. Also checks that the write-only
+// drain posts its reads together, waiting once per drain rather than once per
+// SPI packet. Built without the real libusb.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ch341.h"
+#include "fake_libusb.h"
+
+#define TEST_HOPS               (10000)
+#define TEST_DRAIN_HOPS         (4)
+#define TEST_QUEUE_DEPTH        (4)
+
+static const uint32_t au32Hop[6] = {
+    0x00580005, 0x00EC803C, 0x000004B3, 0x00004E42, 0x08008011, 0x00320000
+};
+
+static bool bCheckAllocations(const char *pcStage, unsigned long ulExpected)
+{
+    if(FAKE_USB_ulAllocations() != ulExpected || CH341TransferAllocations() != ulExpected)
+    {
+        printf("FAIL: %s, %lu transfers allocated (counter %lu), %lu expected\n",
+               pcStage, FAKE_USB_ulAllocations(), CH341TransferAllocations(), ulExpected);
+        return false;
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    unsigned long ulPool;
+    unsigned long ulWaits;
+    bool bOk = true;
+
+    if(!CH341DeviceInit())
+    {
+        printf("FAIL: device init\n");
+        return 1;
+    }
+    ulPool = FAKE_USB_ulAllocations();
+
+    bOk = bOk && bCheckAllocations("after init", ulPool);
+
+    CH341SetWriteOnly(TEST_DRAIN_HOPS);
+    ulWaits = FAKE_USB_ulWaits();
+    for(int n = 0; bOk && n < TEST_HOPS; n++)
+    {
+        bOk = CH341WriteSPIWords(0, au32Hop, 1 + n % 6);
+    }
+    bOk = bOk && CH341FlushSPI();
+    bOk = bOk && bCheckAllocations("blocking writes", ulPool);
+
+    // One wait per OUT transfer and one per drain
+    ulWaits = FAKE_USB_ulWaits() - ulWaits;
+    if(bOk && ulWaits != TEST_HOPS + TEST_HOPS / TEST_DRAIN_HOPS)
+    {
+        printf("FAIL: %lu waits for %d blocking writes, %d expected\n",
+               ulWaits, TEST_HOPS, TEST_HOPS + TEST_HOPS / TEST_DRAIN_HOPS);
+        bOk = false;
+    }
+
+    bOk = bOk && CH341AsyncInit(TEST_QUEUE_DEPTH);
+    for(int n = 0; bOk && n < TEST_HOPS; n++)
+    {
+        bOk = CH341AsyncSubmitWords(0, au32Hop, 1 + n % 6);
+    }
+    for(int n = 0; bOk && n < TEST_HOPS; n++)
+    {
+        bOk = CH341PrepareSPIWords(0, &au32Hop[5], 1) && CH341CommitSPIWords();
+    }
+    bOk = bOk && CH341AsyncFlush();
+    CH341AsyncRelease();
+    bOk = bOk && bCheckAllocations("queued writes", ulPool);
+
+    CH341DeviceRelease();
+
+    printf("%s\n", bOk ? "PASSED" : "FAILED");
+
+    return bOk ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "ch341.h"
+#include "transport.h"
+
+static bool TRANSPORT_bCH341Init(TRANSPORT_tsBackend *psBackend);
+static bool TRANSPORT_bCH341ChipSelect(TRANSPORT_tsBackend *psBackend, bool bEnable);
+static bool TRANSPORT_bCH341Write(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount);
+static bool TRANSPORT_bCH341Prepare(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount);
+static bool TRANSPORT_bCH341Commit(TRANSPORT_tsBackend *psBackend);
+static bool TRANSPORT_bCH341LockDetect(TRANSPORT_tsBackend *psBackend, bool *pbLocked);
+static bool TRANSPORT_bCH341Flush(TRANSPORT_tsBackend *psBackend);
+static void TRANSPORT_vCH341Close(TRANSPORT_tsBackend *psBackend);
+
+static bool TRANSPORT_bMockInit(TRANSPORT_tsBackend *psBackend);
+static bool TRANSPORT_bMockChipSelect(TRANSPORT_tsBackend *psBackend, bool bEnable);
+static bool TRANSPORT_bMockWrite(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount);
+static bool TRANSPORT_bMockPrepare(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount);
+static bool TRANSPORT_bMockCommit(TRANSPORT_tsBackend *psBackend);
+static bool TRANSPORT_bMockLockDetect(TRANSPORT_tsBackend *psBackend, bool *pbLocked);
+static bool TRANSPORT_bMockFlush(TRANSPORT_tsBackend *psBackend);
+static void TRANSPORT_vMockClose(TRANSPORT_tsBackend *psBackend);
+static void TRANSPORT_vMockRecord(TRANSPORT_tsMock *psMock, uint8_t u8Type, uint8_t u8Byte);
+
+// Monotonic time in nanoseconds, only differences are meaningful
+uint64_t TRANSPORT_u64TimeNs(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER sFrequency;
+    LARGE_INTEGER sCount;
+
+    if(sFrequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&sFrequency);
+    }
+    QueryPerformanceCounter(&sCount);
+
+    return (uint64_t)((sCount.QuadPart / sFrequency.QuadPart) * 1000000000ULL +
+                      ((sCount.QuadPart % sFrequency.QuadPart) * 1000000000ULL) / sFrequency.QuadPart);
+#else
+    struct timespec sNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &sNow);
+
+    return (uint64_t)sNow.tv_sec * 1000000000ULL + sNow.tv_nsec;
+#endif
+}
+
+/****************************************************************************/
+/***        CH341 backend                                                 ***/
+/****************************************************************************/
+
+void TRANSPORT_vInitCH341(TRANSPORT_tsBackend *psBackend, TRANSPORT_tsCH341Config *psConfig)
+{
+    psBackend->pcName = "CH341";
+    psBackend->pfInit = TRANSPORT_bCH341Init;
+    psBackend->pfChipSelect = TRANSPORT_bCH341ChipSelect;
+    psBackend->pfWrite = TRANSPORT_bCH341Write;
+    psBackend->pfPrepare = TRANSPORT_bCH341Prepare;
+    psBackend->pfCommit = TRANSPORT_bCH341Commit;
+    psBackend->pfLockDetect = TRANSPORT_bCH341LockDetect;
+    psBackend->pfFlush = TRANSPORT_bCH341Flush;
+    psBackend->pfClose = TRANSPORT_vCH341Close;
+    psBackend->pvContext = psConfig;
+}
+
+static bool TRANSPORT_bCH341Init(TRANSPORT_tsBackend *psBackend)
+{
+    TRANSPORT_tsCH341Config *psConfig = psBackend->pvContext;
+
+    if(!CH341DeviceInit())
+    {
+        return false;
+    }
+
+    // Start with chip select disabled
+    if(!CH341ChipSelect(0, false))
+    {
+        return false;
+    }
+
+    // Let SPI readback accumulate in the CH341 and drain it every few packets
+    CH341SetWriteOnly(psConfig->uDrainHops);
+
+    // Optionally keep several hops in flight on the USB bus
+    if(psConfig->uQueueDepth && !CH341AsyncInit(psConfig->uQueueDepth))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+static bool TRANSPORT_bCH341ChipSelect(TRANSPORT_tsBackend *psBackend, bool bEnable)
+{
+    return CH341ChipSelect(0, bEnable);
+}
+
+static bool TRANSPORT_bCH341Write(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount)
+{
+    return CH341AsyncSubmitWords(0, pu32Words, uCount);
+}
+
+static bool TRANSPORT_bCH341Prepare(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount)
+{
+    return CH341PrepareSPIWords(0, pu32Words, uCount);
+}
+
+static bool TRANSPORT_bCH341Commit(TRANSPORT_tsBackend *psBackend)
+{
+    return CH341CommitSPIWords();
+}
+
+static bool TRANSPORT_bCH341LockDetect(TRANSPORT_tsBackend *psBackend, bool *pbLocked)
+{
+    TRANSPORT_tsCH341Config *psConfig = psBackend->pvContext;
+    unsigned char u8Inputs;
+
+    if(psConfig->uLockDetectPin > 7 || !CH341ReadInputs(&u8Inputs))
+    {
+        return false;
+    }
+
+    *pbLocked = (u8Inputs >> psConfig->uLockDetectPin) & 0x1;
+
+    return true;
+}
+
+static bool TRANSPORT_bCH341Flush(TRANSPORT_tsBackend *psBackend)
+{
+    return CH341AsyncFlush() && CH341FlushSPI();
+}
+
+static void TRANSPORT_vCH341Close(TRANSPORT_tsBackend *psBackend)
+{
+    CH341AsyncRelease();
+    CH341FlushSPI();
+    CH341DeviceRelease();
+}
+
+/****************************************************************************/
+/***        Mock backend                                                  ***/
+/****************************************************************************/
+
+// Records every byte and chip select edge with a monotonic timestamp. Events
+// beyond the capacity of the buffer are counted and passed to the listener
+// but not stored.
+void TRANSPORT_vInitMock(TRANSPORT_tsBackend *psBackend, TRANSPORT_tsMock *psMock, TRANSPORT_tsMockEvent *pasEvents, size_t uCapacity)
+{
+    memset(psMock, 0, sizeof(TRANSPORT_tsMock));
+    psMock->pasEvents = pasEvents;
+    psMock->uCapacity = uCapacity;
+
+    psBackend->pcName = "Mock";
+    psBackend->pfInit = TRANSPORT_bMockInit;
+    psBackend->pfChipSelect = TRANSPORT_bMockChipSelect;
+    psBackend->pfWrite = TRANSPORT_bMockWrite;
+    psBackend->pfPrepare = TRANSPORT_bMockPrepare;
+    psBackend->pfCommit = TRANSPORT_bMockCommit;
+    psBackend->pfLockDetect = TRANSPORT_bMockLockDetect;
+    psBackend->pfFlush = TRANSPORT_bMockFlush;
+    psBackend->pfClose = TRANSPORT_vMockClose;
+    psBackend->pvContext = psMock;
+}
+
+static bool TRANSPORT_bMockInit(TRANSPORT_tsBackend *psBackend)
+{
+    TRANSPORT_tsMock *psMock = psBackend->pvContext;
+
+    psMock->uCount = 0;
+    psMock->u64Bytes = 0;
+    psMock->u64Writes = 0;
+    psMock->u64FirstNs = TRANSPORT_u64TimeNs();
+    psMock->u64LastNs = psMock->u64FirstNs;
+
+    return true;
+}
+
+static bool TRANSPORT_bMockChipSelect(TRANSPORT_tsBackend *psBackend, bool bEnable)
+{
+    TRANSPORT_vMockRecord(psBackend->pvContext, bEnable ? TRANSPORT_MOCK_EVENT_CS_ASSERT : TRANSPORT_MOCK_EVENT_CS_DEASSERT, 0);
+
+    return true;
+}
+
+static bool TRANSPORT_bMockWrite(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount)
+{
+    TRANSPORT_tsMock *psMock = psBackend->pvContext;
+
+    for(unsigned int n = 0; n < uCount; n++)
+    {
+        TRANSPORT_vMockRecord(psMock, TRANSPORT_MOCK_EVENT_CS_ASSERT, 0);
+
+        for(int i = 3; i >= 0; i--)
+        {
+            TRANSPORT_vMockRecord(psMock, TRANSPORT_MOCK_EVENT_BYTE, (pu32Words[n] >> (8 * i)) & 0xff);
+        }
+
+        TRANSPORT_vMockRecord(psMock, TRANSPORT_MOCK_EVENT_CS_DEASSERT, 0);
+    }
+
+    psMock->u64Writes++;
+
+    return true;
+}
+
+static bool TRANSPORT_bMockPrepare(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount)
+{
+    TRANSPORT_tsMock *psMock = psBackend->pvContext;
+
+    if(uCount > sizeof(psMock->au32Staged) / sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    memcpy(psMock->au32Staged, pu32Words, uCount * sizeof(uint32_t));
+    psMock->uStaged = uCount;
+
+    return true;
+}
+
+static bool TRANSPORT_bMockCommit(TRANSPORT_tsBackend *psBackend)
+{
+    TRANSPORT_tsMock *psMock = psBackend->pvContext;
+    unsigned int uCount = psMock->uStaged;
+
+    if(uCount == 0)
+    {
+        return true;
+    }
+
+    psMock->uStaged = 0;
+
+    return TRANSPORT_bMockWrite(psBackend, psMock->au32Staged, uCount);
+}
+
+static bool TRANSPORT_bMockLockDetect(TRANSPORT_tsBackend *psBackend, bool *pbLocked)
+{
+    TRANSPORT_tsMock *psMock = psBackend->pvContext;
+
+    *pbLocked = psMock->pfLockDetect ? psMock->pfLockDetect(psMock->pvUser, TRANSPORT_u64TimeNs()) : true;
+
+    return true;
+}
+
+static bool TRANSPORT_bMockFlush(TRANSPORT_tsBackend *psBackend)
+{
+    return true;
+}
+
+static void TRANSPORT_vMockClose(TRANSPORT_tsBackend *psBackend)
+{
+}
+
+static void TRANSPORT_vMockRecord(TRANSPORT_tsMock *psMock, uint8_t u8Type, uint8_t u8Byte)
+{
+    TRANSPORT_tsMockEvent sEvent;
+
+    sEvent.u64TimeNs = TRANSPORT_u64TimeNs();
+    sEvent.u8Type = u8Type;
+    sEvent.u8Byte = u8Byte;
+
+    // Never let timestamps go backwards
+    if(sEvent.u64TimeNs < psMock->u64LastNs)
+    {
+        sEvent.u64TimeNs = psMock->u64LastNs;
+    }
+    psMock->u64LastNs = sEvent.u64TimeNs;
+
+    if(u8Type == TRANSPORT_MOCK_EVENT_BYTE)
+    {
+        psMock->u64Bytes++;
+    }
+
+    if(psMock->uCount < psMock->uCapacity)
+    {
+        psMock->pasEvents[psMock->uCount++] = sEvent;
+    }
+
+    if(psMock->pfListener)
+    {
+        psMock->pfListener(psMock->pvUser, &sEvent);
+    }
+}
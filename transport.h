@@ -0,0 +1,94 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of ADF435xCFG (ADF435x Configurator)
+ *
+ * ADF435xCFG (ADF435x Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * ADF435xCFG (ADF435x Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ADF435xCFG (ADF435x Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Mock event flags
+#define TRANSPORT_MOCK_EVENT_BYTE           (0)
+#define TRANSPORT_MOCK_EVENT_CS_ASSERT      (1)
+#define TRANSPORT_MOCK_EVENT_CS_DEASSERT    (2)
+
+typedef struct TRANSPORT_tsBackend TRANSPORT_tsBackend;
+
+// SPI transport used to write register words. pfWrite sends each word MSB
+// first, latched by its own chip select (LE) pulse. pfPrepare does all the
+// work for a write up front, leaving pfCommit to send it with as little
+// delay as possible. pfLockDetect samples the PLL lock detect signal.
+struct TRANSPORT_tsBackend {
+    const char *pcName;
+    bool (*pfInit)(TRANSPORT_tsBackend *psBackend);
+    bool (*pfChipSelect)(TRANSPORT_tsBackend *psBackend, bool bEnable);
+    bool (*pfWrite)(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount);
+    bool (*pfPrepare)(TRANSPORT_tsBackend *psBackend, const uint32_t *pu32Words, unsigned int uCount);
+    bool (*pfCommit)(TRANSPORT_tsBackend *psBackend);
+    bool (*pfLockDetect)(TRANSPORT_tsBackend *psBackend, bool *pbLocked);
+    bool (*pfFlush)(TRANSPORT_tsBackend *psBackend);
+    void (*pfClose)(TRANSPORT_tsBackend *psBackend);
+    void *pvContext;
+};
+
+typedef struct {
+    unsigned int uDrainHops;
+    unsigned int uQueueDepth;
+
+    // CH341 D input (0~7) wired to the ADF435x MUXOUT or LD pin
+    unsigned int uLockDetectPin;
+} TRANSPORT_tsCH341Config;
+
+typedef struct {
+    uint64_t u64TimeNs;
+    uint8_t u8Type;
+    uint8_t u8Byte;
+} TRANSPORT_tsMockEvent;
+
+typedef struct {
+    TRANSPORT_tsMockEvent *pasEvents;
+    size_t uCapacity;
+    size_t uCount;
+
+    uint64_t u64Bytes;
+    uint64_t u64Writes;
+    uint64_t u64FirstNs;
+    uint64_t u64LastNs;
+
+    // Words held by pfPrepare until pfCommit
+    uint32_t au32Staged[6];
+    unsigned int uStaged;
+
+    // Optional listener, called for every event whether or not it was stored
+    void (*pfListener)(void *pvUser, const TRANSPORT_tsMockEvent *psEvent);
+    void *pvUser;
+
+    // Optional lock detect signal, without it the mock always reports lock
+    bool (*pfLockDetect)(void *pvUser, uint64_t u64TimeNs);
+} TRANSPORT_tsMock;
+
+uint64_t TRANSPORT_u64TimeNs(void);
+
+void TRANSPORT_vInitCH341(TRANSPORT_tsBackend *psBackend, TRANSPORT_tsCH341Config *psConfig);
+void TRANSPORT_vInitMock(TRANSPORT_tsBackend *psBackend, TRANSPORT_tsMock *psMock, TRANSPORT_tsMockEvent *pasEvents, size_t uCapacity);
+
+#endif // _TRANSPORT_H_